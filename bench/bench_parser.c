@@ -0,0 +1,156 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "parser.h"
+#include "pipes.h"
+#include "parser_reference.h"
+
+// microbenchmark for command parsing
+// reports ns/command over corpora of realistic commands, one per line in
+// the files given on the command line, plus generated long argument lists.
+// each corpus is parsed with the byte at a time reference parser, with
+// parse_command into a reused arena, compiled into pipeline plans and looked
+// up in the plan cache
+
+// every measurement parses about this much input
+#define TARGET_BYTES (64 << 20)
+#define MAX_CORPUS 1024
+#define GENERATED_COMMANDS 16
+
+typedef struct {
+    const char *name;
+    char *commands[MAX_CORPUS];
+    int count;
+    size_t bytes;
+} corpus_t;
+
+static double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+static int add_command(corpus_t *corpus, const char *command) {
+    if (corpus->count == MAX_CORPUS) return -1;
+    corpus->commands[corpus->count] = strdup(command);
+    if (!corpus->commands[corpus->count]) {
+        perror("strdup");
+        exit(EXIT_FAILURE);
+    }
+    corpus->bytes += strlen(command);
+    corpus->count++;
+    return 0;
+}
+
+static int load_corpus(corpus_t *corpus, const char *path) {
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        perror(path);
+        return -1;
+    }
+    const char *slash = strrchr(path, '/');
+    corpus->name = slash ? slash + 1 : path;
+    char line[4096];
+    while (fgets(line, sizeof(line), file)) {
+        line[strcspn(line, "\n")] = '\0';
+        if (line[0] && add_command(corpus, line) != 0) break;
+    }
+    fclose(file);
+    return corpus->count > 0 ? 0 : -1;
+}
+
+// commands with long lists of file path arguments
+static void generate_corpus(corpus_t *corpus) {
+    corpus->name = "generated";
+    char command[16384];
+    for (int i = 0; i < GENERATED_COMMANDS; i++) {
+        int args = 64 << (i % 3);
+        size_t used = snprintf(command, sizeof(command), "wc -l");
+        for (int j = 0; j < args && used < sizeof(command) - 64; j++) {
+            used += snprintf(command + used, sizeof(command) - used, " /var/log/app/shard-%02d/part-%05d.log",
+                             j % 32, i * 1000 + j);
+        }
+        add_command(corpus, command);
+    }
+}
+
+static long rounds_for(const corpus_t *corpus) {
+    return TARGET_BYTES / corpus->bytes + 1;
+}
+
+static double bench_parse(const corpus_t *corpus, Command *(*parse)(parse_arena_t *, const char *)) {
+    static char buffer[1 << 20];
+    parse_arena_t arena;
+    parse_arena_init(&arena, buffer, sizeof(buffer));
+    long rounds = rounds_for(corpus);
+    double start = now_ms();
+    for (long r = 0; r < rounds; r++) {
+        for (int i = 0; i < corpus->count; i++) {
+            Command *cmd = parse(&arena, corpus->commands[i]);
+            if (!cmd) {
+                fprintf(stderr, "failed to parse: %s\n", corpus->commands[i]);
+                exit(EXIT_FAILURE);
+            }
+            free_command(&arena, cmd);
+        }
+    }
+    return (now_ms() - start) * 1e6 / (rounds * corpus->count);
+}
+
+static double bench_compile(const corpus_t *corpus) {
+    long rounds = rounds_for(corpus);
+    double start = now_ms();
+    for (long r = 0; r < rounds; r++) {
+        for (int i = 0; i < corpus->count; i++) {
+            pipeline_plan_t *plan = pipeline_plan_compile(corpus->commands[i], -1);
+            if (!plan) exit(EXIT_FAILURE);
+            pipeline_plan_release(plan);
+        }
+    }
+    return (now_ms() - start) * 1e6 / (rounds * corpus->count);
+}
+
+static double bench_cached(const corpus_t *corpus) {
+    long rounds = rounds_for(corpus);
+    double start = now_ms();
+    for (long r = 0; r < rounds; r++) {
+        for (int i = 0; i < corpus->count; i++) {
+            pipeline_plan_t *plan = pipeline_plan_get(corpus->commands[i], -1);
+            if (!plan) exit(EXIT_FAILURE);
+            pipeline_plan_release(plan);
+        }
+    }
+    return (now_ms() - start) * 1e6 / (rounds * corpus->count);
+}
+
+int main(int argc, char *argv[]) {
+    corpus_t *corpora = calloc(argc, sizeof(corpus_t));
+    if (!corpora) {
+        perror("calloc");
+        return EXIT_FAILURE;
+    }
+    int count = 0;
+    for (int i = 1; i < argc; i++) {
+        if (load_corpus(&corpora[count], argv[i]) == 0) count++;
+    }
+    generate_corpus(&corpora[count++]);
+
+    printf("%-16s %6s %8s %12s %12s %12s %12s\n", "corpus", "cmds", "bytes", "reference",
+           "parse", "compile", "cached");
+    printf("%-16s %6s %8s %12s %12s %12s %12s\n", "", "", "avg", "ns/cmd", "ns/cmd", "ns/cmd", "ns/cmd");
+    for (int i = 0; i < count; i++) {
+        corpus_t *corpus = &corpora[i];
+        double reference = bench_parse(corpus, reference_parse_command);
+        double parse = bench_parse(corpus, parse_command);
+        double compile = bench_compile(corpus);
+        double cached = bench_cached(corpus);
+        printf("%-16s %6d %8zu %12.1f %12.1f %12.1f %12.1f\n", corpus->name, corpus->count,
+               corpus->bytes / corpus->count, reference, parse, compile, cached);
+        for (int j = 0; j < corpus->count; j++) free(corpus->commands[j]);
+    }
+    pipeline_cache_cleanup();
+    free(corpora);
+    return 0;
+}
@@ -0,0 +1,160 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "scheduler.h"
+#include "task_heap.h"
+
+// microbenchmark for the scheduler run queue
+// compares the indexed heap against the old array scan/shift queue for
+// picking, requeueing and removing tasks at growing queue sizes
+
+#define PICK_ROUNDS 100000
+
+static double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+static int program_task_less(const task_t *a, const task_t *b) {
+    if (a->remaining_time != b->remaining_time) {
+        return a->remaining_time < b->remaining_time;
+    }
+    return a->id < b->id;
+}
+
+static task_t *make_tasks(int n) {
+    task_t *tasks = calloc(n, sizeof(task_t));
+    if (!tasks) {
+        perror("calloc");
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < n; i++) {
+        tasks[i].id = i + 1;
+        tasks[i].type = TASK_PROGRAM;
+        tasks[i].remaining_time = 1 + rand() % 1000;
+        tasks[i].heap_index = -1;
+    }
+    return tasks;
+}
+
+// random permutation used as the removal order
+static int *make_order(int n) {
+    int *order = malloc(n * sizeof(int));
+    if (!order) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < n; i++) order[i] = i;
+    for (int i = n - 1; i > 0; i--) {
+        int j = rand() % (i + 1);
+        int tmp = order[i];
+        order[i] = order[j];
+        order[j] = tmp;
+    }
+    return order;
+}
+
+static void bench_heap(int n) {
+    task_t *tasks = make_tasks(n);
+    int *order = make_order(n);
+    task_heap_t heap;
+    if (task_heap_init(&heap, program_task_less) != 0) {
+        perror("task_heap_init");
+        exit(EXIT_FAILURE);
+    }
+    
+    double start = now_ms();
+    for (int i = 0; i < n; i++) task_heap_push(&heap, &tasks[i]);
+    double push_ms = now_ms() - start;
+    
+    // pick the shortest task, charge it a quantum and requeue it
+    start = now_ms();
+    for (int i = 0; i < PICK_ROUNDS; i++) {
+        task_t *task = task_heap_pop(&heap);
+        task->remaining_time += 7;
+        task_heap_push(&heap, task);
+    }
+    double pick_ms = now_ms() - start;
+    
+    start = now_ms();
+    for (int i = 0; i < n; i++) task_heap_remove(&heap, &tasks[order[i]]);
+    double remove_ms = now_ms() - start;
+    
+    printf("%-8s %8d %14.1f %14.1f %14.1f\n", "heap", n,
+           push_ms * 1e6 / n, pick_ms * 1e6 / PICK_ROUNDS, remove_ms * 1e6 / n);
+    task_heap_destroy(&heap);
+    free(order);
+    free(tasks);
+}
+
+// the previous queue: append, two linear scans per pick, shift on removal
+static void bench_array(int n) {
+    task_t *tasks = make_tasks(n);
+    int *order = make_order(n);
+    task_t **queue = malloc(n * sizeof(task_t *));
+    if (!queue) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    int size = 0;
+    
+    double start = now_ms();
+    for (int i = 0; i < n; i++) queue[size++] = &tasks[i];
+    double push_ms = now_ms() - start;
+    
+    int rounds = PICK_ROUNDS / 100;
+    start = now_ms();
+    for (int r = 0; r < rounds; r++) {
+        task_t *selected = NULL;
+        for (int i = 0; i < size; i++) {
+            if (queue[i]->type == TASK_SHELL_COMMAND) {
+                selected = queue[i];
+                break;
+            }
+        }
+        for (int i = 0; i < size && !selected; i++) {
+            if (!selected || queue[i]->remaining_time < selected->remaining_time) {
+                selected = queue[i];
+            }
+        }
+        selected->remaining_time += 7;
+    }
+    double pick_ms = now_ms() - start;
+    
+    start = now_ms();
+    for (int k = 0; k < n; k++) {
+        task_t *task = &tasks[order[k]];
+        for (int i = 0; i < size; i++) {
+            if (queue[i] == task) {
+                for (int j = i; j < size - 1; j++) queue[j] = queue[j + 1];
+                size--;
+                break;
+            }
+        }
+    }
+    double remove_ms = now_ms() - start;
+    
+    printf("%-8s %8d %14.1f %14.1f %14.1f\n", "array", n,
+           push_ms * 1e6 / n, pick_ms * 1e6 / rounds, remove_ms * 1e6 / n);
+    free(queue);
+    free(order);
+    free(tasks);
+}
+
+int main(int argc, char *argv[]) {
+    int sizes[] = {100, 1000, 10000, 50000};
+    int count = sizeof(sizes) / sizeof(sizes[0]);
+    // the array queue is quadratic, only run it up to this size
+    int array_limit = argc > 1 ? atoi(argv[1]) : 10000;
+    
+    srand(42);
+    printf("%-8s %8s %14s %14s %14s\n", "queue", "tasks", "push ns/op", "pick ns/op", "remove ns/op");
+    for (int i = 0; i < count; i++) {
+        bench_heap(sizes[i]);
+        if (sizes[i] <= array_limit) bench_array(sizes[i]);
+    }
+    return 0;
+}
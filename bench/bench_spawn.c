@@ -0,0 +1,101 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "parser.h"
+#include "executor.h"
+#include "launcher.h"
+
+// microbenchmark for process launch
+// compares the old fork + execvp path against spawn_command (posix_spawn)
+// and the launch helper while the resident set of the launching process
+// grows, fork has to copy the page tables of the whole server, posix_spawn
+// does not and the helper was forked before the server grew
+
+#define PAGE_TOUCH_STRIDE 4096
+
+static double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+// the old executor path
+static pid_t fork_command(Command *cmd) {
+    pid_t pid = fork();
+    if (pid == 0) {
+        execvp(cmd->args[0], cmd->args);
+        _exit(127);
+    }
+    return pid;
+}
+
+static double bench_launch(const char *name, pid_t (*launch)(Command *), Command *cmd,
+                           int rounds, size_t rss_mb) {
+    double start = now_ms();
+    for (int i = 0; i < rounds; i++) {
+        pid_t pid = launch(cmd);
+        if (pid < 0) {
+            perror("launch");
+            exit(EXIT_FAILURE);
+        }
+        waitpid(pid, NULL, 0);  // already reaped for the helper
+    }
+    double elapsed = now_ms() - start;
+    double per_sec = rounds * 1000.0 / elapsed;
+    printf("%-8s %8zu %8d %14.1f %14.1f\n", name, rss_mb, rounds, per_sec, elapsed * 1000.0 / rounds);
+    return per_sec;
+}
+
+static pid_t spawn_launch(Command *cmd) {
+    return spawn_command(cmd, -1, -1, -1);
+}
+
+// launch and reap through the helper, the exit report comes over its pipe
+static pid_t helper_launch(Command *cmd) {
+    int exit_fd, status;
+    struct rusage usage;
+    pid_t pid = launcher_spawn(cmd, -1, -1, -1, &exit_fd);
+    if (pid > 0) launcher_reap(pid, &exit_fd, 0, &status, &usage);
+    return pid;
+}
+
+int main(int argc, char *argv[]) {
+    size_t sizes_mb[] = {16, 256, 1024};
+    int count = sizeof(sizes_mb) / sizeof(sizes_mb[0]);
+    int rounds = argc > 1 ? atoi(argv[1]) : 500;
+
+    char *args[] = {"true", NULL};
+    Command cmd = { args, NULL, NULL, NULL, 0 };
+
+    // the helper is forked while the process is still small
+    if (launcher_start() != 0) return EXIT_FAILURE;
+
+    char *ballast = NULL;
+    size_t ballast_size = 0;
+    printf("%-8s %8s %8s %14s %14s\n", "launch", "rss MB", "cmds", "cmds/sec", "us/cmd");
+    for (int i = 0; i < count; i++) {
+        // grow the resident set and touch every page so fork has to copy it
+        size_t size = sizes_mb[i] << 20;
+        char *grown = realloc(ballast, size);
+        if (!grown) {
+            perror("realloc");
+            break;
+        }
+        ballast = grown;
+        for (size_t off = ballast_size; off < size; off += PAGE_TOUCH_STRIDE) ballast[off] = 1;
+        ballast_size = size;
+
+        double fork_rate = bench_launch("fork", fork_command, &cmd, rounds, sizes_mb[i]);
+        double spawn_rate = bench_launch("spawn", spawn_launch, &cmd, rounds, sizes_mb[i]);
+        double helper_rate = bench_launch("helper", helper_launch, &cmd, rounds, sizes_mb[i]);
+        printf("%-8s %8zu %8s %13.2fx %13.2fx\n", "speedup", sizes_mb[i], "",
+               spawn_rate / fork_rate, helper_rate / fork_rate);
+    }
+    free(ballast);
+    launcher_stop();
+    return 0;
+}
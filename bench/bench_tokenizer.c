@@ -0,0 +1,90 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "parser.h"
+#include "scan.h"
+#include "parser_reference.h"
+
+// microbenchmark for the parser's classifier
+// parses long generated command lines, argument lists of file paths with a
+// few quoted ones and redirections, with the byte at a time reference parser
+// and with parse_command at every classifier level the cpu supports
+
+#define TARGET_BYTES (256 << 20)
+
+static double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+// a command with args file path arguments, every eighth one quoted
+static char *make_command(int args) {
+    size_t size = 64 + (size_t)args * 64;
+    char *command = malloc(size);
+    if (!command) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    size_t used = snprintf(command, size, "grep -n -e pattern");
+    for (int i = 0; i < args; i++) {
+        // the quoted paths have a space in them
+        int quoted = i % 8 == 7;
+        const char *quote = quoted ? "\"" : "";
+        used += snprintf(command + used, size - used, " %s/srv/data/shard-%03d/segment%s%05d.log%s",
+                         quote, i % 64, quoted ? " " : "-", i, quote);
+    }
+    snprintf(command + used, size - used, " > /tmp/matches.txt 2> /dev/null");
+    return command;
+}
+
+static double bench_parse(const char *name, Command *(*parse)(parse_arena_t *, const char *),
+                          const char *command, int args) {
+    size_t length = strlen(command);
+    size_t size = parse_arena_size(length);
+    char *buffer = malloc(size);
+    if (!buffer) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    parse_arena_t arena;
+    parse_arena_init(&arena, buffer, size);
+
+    long rounds = TARGET_BYTES / length + 1;
+    double start = now_ms();
+    for (long i = 0; i < rounds; i++) {
+        Command *cmd = parse(&arena, command);
+        if (!cmd) {
+            fprintf(stderr, "%s failed to parse the command\n", name);
+            exit(EXIT_FAILURE);
+        }
+        free_command(&arena, cmd);
+    }
+    double elapsed = now_ms() - start;
+    double mb_per_sec = (double)length * rounds / (elapsed / 1000.0) / (1 << 20);
+    printf("%-10s %6d %8zu %12.1f %12.0f\n", name, args, length, mb_per_sec, elapsed * 1e6 / rounds);
+    free(buffer);
+    return mb_per_sec;
+}
+
+int main(void) {
+    int arg_counts[] = {8, 64, 512, 4096};
+    int count = sizeof(arg_counts) / sizeof(arg_counts[0]);
+
+    int best = scan_set_level(SCAN_LEVEL_BEST);
+    printf("%-10s %6s %8s %12s %12s\n", "parser", "args", "bytes", "MB/s", "ns/command");
+    for (int i = 0; i < count; i++) {
+        char *command = make_command(arg_counts[i]);
+        double reference = bench_parse("reference", reference_parse_command, command, arg_counts[i]);
+        double fastest = 0;
+        for (int level = SCAN_LEVEL_SCALAR; level <= best; level++) {
+            scan_set_level(level);
+            fastest = bench_parse(scan_level_name(level), parse_command, command, arg_counts[i]);
+        }
+        printf("%-10s %6d %8s %11.2fx\n", "speedup", arg_counts[i], "", fastest / reference);
+        free(command);
+    }
+    return 0;
+}
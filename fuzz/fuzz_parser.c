@@ -0,0 +1,293 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include "parser.h"
+#include "pipes.h"
+#include "parser_reference.h"
+#ifdef __SANITIZE_ADDRESS__
+#include <sanitizer/common_interface_defs.h>
+#endif
+
+// fuzz harness for parse_command, free_command and the pipeline splitter
+// LLVMFuzzerTestOneInput is the libFuzzer entry point, clang builds it with
+// -DFUZZ_LIBFUZZER -fsanitize=fuzzer. without libFuzzer the driver below runs
+// the inputs named on the command line, files or directories of them, or
+// stdin when there are none, which is how AFL runs a target. with -r N it
+// also runs N random mutations of those inputs, so a plain gcc ASan build
+// fuzzes on its own
+//
+// every input is parsed into an arena of exactly parse_arena_size bytes on
+// the heap so ASan sees any write past it, checked against the reference
+// parser, parsed again on top of the first command and rewound, and compiled
+// as a pipeline plan
+
+#define MAX_FUZZ_INPUT 65536
+
+static int null_fd = -1;
+static int report_fd = STDERR_FILENO;   // where failures go once stderr is silenced
+
+// abort with the input so the fuzzer or the driver records the crash
+static void fail(const char *what, const char *input) {
+    dprintf(report_fd, "fuzz_parser: %s for input \"%s\"\n", what, input);
+    abort();
+}
+
+static int inside(const parse_arena_t *arena, const char *p) {
+    return p >= arena->base && p < arena->base + arena->used;
+}
+
+// every string of cmd lies in the arena and is no longer than the input
+static void check_command(const parse_arena_t *arena, const Command *cmd, const char *input, size_t length) {
+    if (!inside(arena, (const char *)cmd) || !inside(arena, (const char *)cmd->args)) {
+        fail("command outside its arena", input);
+    }
+    if (!cmd->args[0]) fail("command without arguments", input);
+    for (int i = 0; cmd->args[i]; i++) {
+        if (!inside(arena, cmd->args[i]) || strlen(cmd->args[i]) > length) fail("bad argument", input);
+    }
+    const char *files[] = { cmd->input_file, cmd->output_file, cmd->error_file };
+    for (int i = 0; i < 3; i++) {
+        if (files[i] && (!inside(arena, files[i]) || strlen(files[i]) > length)) fail("bad redirection", input);
+    }
+}
+
+static int same_string(const char *a, const char *b) {
+    return (!a && !b) || (a && b && strcmp(a, b) == 0);
+}
+
+static int same_command(const Command *a, const Command *b) {
+    if (!a || !b) return a == b;
+    int i;
+    for (i = 0; a->args[i] && b->args[i]; i++) {
+        if (strcmp(a->args[i], b->args[i]) != 0) return 0;
+    }
+    return !a->args[i] && !b->args[i] && same_string(a->input_file, b->input_file) &&
+           same_string(a->output_file, b->output_file) && same_string(a->error_file, b->error_file) &&
+           a->pipe_count == b->pipe_count;
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+    if (null_fd < 0) null_fd = open("/dev/null", O_WRONLY | O_CLOEXEC);
+    if (size > MAX_FUZZ_INPUT) size = MAX_FUZZ_INPUT;
+    // commands arrive as strings, anything after a NUL is never seen
+    char *input = malloc(size + 1);
+    if (!input) return 0;
+    memcpy(input, data, size);
+    input[size] = '\0';
+    size_t length = strlen(input);
+
+    // two commands stacked in one arena, sized exactly for the worst case
+    size_t arena_size = 2 * parse_arena_size(length);
+    char *buffer = malloc(arena_size);
+    char *reference_buffer = malloc(arena_size);
+    if (!buffer || !reference_buffer) {
+        free(input);
+        free(buffer);
+        free(reference_buffer);
+        return 0;
+    }
+    parse_arena_t arena, reference_arena;
+    parse_arena_init(&arena, buffer, arena_size);
+    parse_arena_init(&reference_arena, reference_buffer, arena_size);
+
+    Command *cmd = parse_command(&arena, input);
+    Command *expected = reference_parse_command(&reference_arena, input);
+    if (!same_command(cmd, expected)) fail("parse differs from the reference parser", input);
+    if (cmd) {
+        check_command(&arena, cmd, input, length);
+        size_t used = arena.used;
+        Command *second = parse_command(&arena, input);
+        if (!second || !same_command(cmd, second)) fail("second parse differs", input);
+        check_command(&arena, second, input, length);
+        free_command(&arena, second);
+        if (arena.used != used) fail("free_command did not rewind to the second command", input);
+        free_command(&arena, cmd);
+    }
+    if (arena.used != 0) fail("arena not empty after free_command", input);
+
+    // the pipeline splitter and the per stage parse
+    pipeline_plan_t *plan = pipeline_plan_compile(input, null_fd);
+    if (plan) {
+        if (plan->stage_count < 1 || plan->stage_count > MAX_COMMANDS) fail("bad stage count", input);
+        for (int i = 0; i < plan->stage_count; i++) {
+            check_command(&plan->arena, plan->stages[i], input, length);
+        }
+        pipeline_plan_release(plan);
+    }
+
+    free(input);
+    free(buffer);
+    free(reference_buffer);
+    return 0;
+}
+
+#ifndef FUZZ_LIBFUZZER
+
+static const char mutation_bytes[] = " \t\"'\\<>|2";
+
+static unsigned long long rng_state = 0x9e3779b97f4a7c15ULL;
+
+static unsigned next_random(void) {
+    // xorshift64*
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return (unsigned)((rng_state * 2685821657736338717ULL) >> 32);
+}
+
+// the inputs the driver was given
+static char **seeds = NULL;
+static size_t *seed_sizes = NULL;
+static int seed_count = 0;
+
+static int add_seed(const char *path) {
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        perror(path);
+        return -1;
+    }
+    char *data = malloc(MAX_FUZZ_INPUT);
+    char **grown_seeds = realloc(seeds, (seed_count + 1) * sizeof(char *));
+    if (grown_seeds) seeds = grown_seeds;
+    size_t *grown_sizes = realloc(seed_sizes, (seed_count + 1) * sizeof(size_t));
+    if (grown_sizes) seed_sizes = grown_sizes;
+    if (!data || !grown_seeds || !grown_sizes) {
+        perror("malloc");
+        free(data);
+        fclose(file);
+        return -1;
+    }
+    seed_sizes[seed_count] = fread(data, 1, MAX_FUZZ_INPUT, file);
+    seeds[seed_count++] = data;
+    fclose(file);
+    return 0;
+}
+
+// add a file, or every file in a directory
+static int add_path(const char *path) {
+    struct stat st;
+    if (stat(path, &st) != 0) {
+        perror(path);
+        return -1;
+    }
+    if (!S_ISDIR(st.st_mode)) return add_seed(path);
+    DIR *dir = opendir(path);
+    if (!dir) {
+        perror(path);
+        return -1;
+    }
+    struct dirent *entry;
+    char file[4096];
+    while ((entry = readdir(dir))) {
+        if (entry->d_name[0] == '.') continue;
+        snprintf(file, sizeof(file), "%s/%s", path, entry->d_name);
+        if (add_seed(file) != 0) {
+            closedir(dir);
+            return -1;
+        }
+    }
+    closedir(dir);
+    return 0;
+}
+
+// a random seed with a few random edits, returns the new size
+static size_t mutate(char *out) {
+    size_t size = 0;
+    if (seed_count > 0) {
+        int seed = next_random() % seed_count;
+        size = seed_sizes[seed];
+        memcpy(out, seeds[seed], size);
+    }
+    int edits = 1 + next_random() % 8;
+    for (int i = 0; i < edits; i++) {
+        unsigned kind = next_random() % 4;
+        size_t at = size ? next_random() % (size + 1) : 0;
+        char byte = next_random() % 2 ? mutation_bytes[next_random() % (sizeof(mutation_bytes) - 1)]
+                                      : (char)(next_random() % 256);
+        if (kind == 0 && size < MAX_FUZZ_INPUT) {
+            // insert a byte
+            memmove(out + at + 1, out + at, size - at);
+            out[at] = byte;
+            size++;
+        } else if (kind == 1 && at < size) {
+            // drop a byte
+            memmove(out + at, out + at + 1, size - at - 1);
+            size--;
+        } else if (kind == 2 && at < size) {
+            out[at] = byte;
+        } else if (seed_count > 0) {
+            // splice in the start of another seed
+            int other = next_random() % seed_count;
+            size_t count = seed_sizes[other] ? next_random() % seed_sizes[other] : 0;
+            if (size + count > MAX_FUZZ_INPUT) count = MAX_FUZZ_INPUT - size;
+            memmove(out + at + count, out + at, size - at);
+            memcpy(out + at, seeds[other], count);
+            size += count;
+        }
+    }
+    return size;
+}
+
+int main(int argc, char *argv[]) {
+    long runs = 0;
+    int opt;
+    while ((opt = getopt(argc, argv, "r:s:")) != -1) {
+        switch (opt) {
+        case 'r':
+            runs = atol(optarg);
+            break;
+        case 's':
+            rng_state = strtoull(optarg, NULL, 0);
+            if (rng_state == 0) rng_state = 1;
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-r runs] [-s seed] [input file or directory]...\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    for (int i = optind; i < argc; i++) {
+        if (add_path(argv[i]) != 0) return EXIT_FAILURE;
+    }
+    // parse errors are expected and not interesting, failures and sanitizer
+    // reports keep going to the real stderr
+    report_fd = dup(STDERR_FILENO);
+#ifdef __SANITIZE_ADDRESS__
+    __sanitizer_set_report_fd((void *)(intptr_t)report_fd);
+#endif
+    if (!freopen("/dev/null", "w", stderr)) perror("freopen");
+
+    if (optind == argc && runs == 0) {
+        // a single input on stdin
+        char *data = malloc(MAX_FUZZ_INPUT);
+        if (!data) return EXIT_FAILURE;
+        size_t size = fread(data, 1, MAX_FUZZ_INPUT, stdin);
+        LLVMFuzzerTestOneInput((const uint8_t *)data, size);
+        free(data);
+        return 0;
+    }
+
+    for (int i = 0; i < seed_count; i++) {
+        LLVMFuzzerTestOneInput((const uint8_t *)seeds[i], seed_sizes[i]);
+    }
+    char *mutated = malloc(MAX_FUZZ_INPUT);
+    if (!mutated) return EXIT_FAILURE;
+    for (long i = 0; i < runs; i++) {
+        size_t size = mutate(mutated);
+        LLVMFuzzerTestOneInput((const uint8_t *)mutated, size);
+    }
+    printf("ok, %d inputs and %ld mutations\n", seed_count, runs);
+
+    free(mutated);
+    for (int i = 0; i < seed_count; i++) free(seeds[i]);
+    free(seeds);
+    free(seed_sizes);
+    return 0;
+}
+
+#endif
@@ -0,0 +1,156 @@
+#define _DEFAULT_SOURCE  // MAP_ANONYMOUS
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "parser.h"
+#include "scan.h"
+#include "parser_reference.h"
+
+// differential fuzzer for the classifier driven parser
+// random command lines heavy in spaces, quotes, escapes and operators are
+// parsed by parse_command with every classifier level the cpu supports and
+// by the byte at a time reference parser, the results have to be identical.
+// scan_until itself is checked against the scalar classifier for random
+// class sets, and some inputs end right before an unmapped page so a block
+// load past the NUL would fault
+
+#define MAX_INPUT 4096
+#define ARENA_MISALIGNMENTS 8
+
+static const char special_bytes[] = " \t\n\v\f\r\"'\\<>|2";
+static const char plain_bytes[] = "abcxyz019/._-=*";
+
+static unsigned long long rng_state;
+
+static unsigned next_random(void) {
+    // xorshift64*
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return (unsigned)((rng_state * 2685821657736338717ULL) >> 32);
+}
+
+static size_t random_input(char *input) {
+    size_t length = next_random() % 16 == 0 ? next_random() % MAX_INPUT : next_random() % 64;
+    for (size_t i = 0; i < length; i++) {
+        unsigned pick = next_random() % 100;
+        if (pick < 2) input[i] = (char)(1 + next_random() % 255);
+        else if (pick < 50) input[i] = special_bytes[next_random() % (sizeof(special_bytes) - 1)];
+        else input[i] = plain_bytes[next_random() % (sizeof(plain_bytes) - 1)];
+    }
+    input[length] = '\0';
+    return length;
+}
+
+static int same_string(const char *a, const char *b) {
+    return (!a && !b) || (a && b && strcmp(a, b) == 0);
+}
+
+static int same_command(const Command *a, const Command *b) {
+    if (!a || !b) return a == b;
+    int i;
+    for (i = 0; a->args[i] && b->args[i]; i++) {
+        if (strcmp(a->args[i], b->args[i]) != 0) return 0;
+    }
+    return !a->args[i] && !b->args[i] &&
+           same_string(a->input_file, b->input_file) &&
+           same_string(a->output_file, b->output_file) &&
+           same_string(a->error_file, b->error_file) &&
+           a->pipe_count == b->pipe_count;
+}
+
+static void print_input(const char *input) {
+    printf("input: \"");
+    for (const unsigned char *c = (const unsigned char *)input; *c; c++) {
+        if (*c == '"' || *c == '\\') printf("\\%c", *c);
+        else if (*c >= 0x20 && *c < 0x7f) putchar(*c);
+        else printf("\\x%02x", *c);
+    }
+    printf("\"\n");
+}
+
+// parse input with both parsers into arenas of the exact worst case size at
+// a given misalignment, returns -1 if they disagree, 1 if both parsed it
+// and 0 if both rejected it
+static int check_parse(const char *input, size_t length, size_t misalign) {
+    static char expected_buffer[MAX_INPUT * 8];
+    static char actual_buffer[MAX_INPUT * 8];
+    size_t size = parse_arena_size(length);
+    parse_arena_t expected_arena, actual_arena;
+    parse_arena_init(&expected_arena, expected_buffer + misalign, size);
+    parse_arena_init(&actual_arena, actual_buffer + misalign, size);
+
+    Command *expected = reference_parse_command(&expected_arena, input);
+    Command *actual = parse_command(&actual_arena, input);
+    if (!same_command(expected, actual) || expected_arena.used != actual_arena.used) return -1;
+    return actual != NULL;
+}
+
+// scan_until at the current level against the scalar classifier
+static int check_scan(const char *input, size_t length, int level) {
+    unsigned classes = next_random() % 32;
+    size_t start = length ? next_random() % (length + 1) : 0;
+    scan_set_level(SCAN_LEVEL_SCALAR);
+    const char *expected = scan_until(input + start, classes);
+    scan_set_level(level);
+    const char *actual = scan_until(input + start, classes);
+    if (expected == actual) return 0;
+    printf("scan_until mismatch at level %s, classes 0x%x, start %zu: %td instead of %td\n",
+           scan_level_name(level), classes, start, actual - input, expected - input);
+    return -1;
+}
+
+int main(int argc, char *argv[]) {
+    long iterations = argc > 1 ? atol(argv[1]) : 1000000;
+    rng_state = argc > 2 ? strtoull(argv[2], NULL, 0) : 0x9e3779b97f4a7c15ULL;
+    if (rng_state == 0) rng_state = 1;
+
+    // an input buffer that ends at an unmapped page
+    long page = sysconf(_SC_PAGESIZE);
+    size_t guarded_size = ((MAX_INPUT + page - 1) / page) * page;
+    char *guarded = mmap(NULL, guarded_size + page, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (guarded == MAP_FAILED || mprotect(guarded + guarded_size, page, PROT_NONE) != 0) {
+        perror("mmap");
+        return EXIT_FAILURE;
+    }
+
+    int levels = scan_set_level(SCAN_LEVEL_BEST) + 1;
+    printf("fuzzing %ld inputs, classifier levels:", iterations);
+    for (int level = 0; level < levels; level++) printf(" %s", scan_level_name(level));
+    printf("\n");
+    fflush(stdout);
+    // both parsers report rejected inputs, which are expected here
+    if (!freopen("/dev/null", "w", stderr)) perror("freopen");
+
+    static char input[MAX_INPUT + 1];
+    long parsed = 0;
+    for (long i = 0; i < iterations; i++) {
+        size_t length = random_input(input);
+        // every few inputs are moved to end right before the unmapped page
+        const char *subject = input;
+        if (i % 8 == 0) {
+            char *moved = guarded + guarded_size - length - 1;
+            memcpy(moved, input, length + 1);
+            subject = moved;
+        }
+        for (int level = 0; level < levels; level++) {
+            scan_set_level(level);
+            int result = check_parse(subject, length, i % ARENA_MISALIGNMENTS);
+            if (result < 0) {
+                printf("parse mismatch at level %s\n", scan_level_name(level));
+                print_input(subject);
+                return EXIT_FAILURE;
+            }
+            if (level == 0) parsed += result;
+            if (check_scan(subject, length, level) != 0) {
+                print_input(subject);
+                return EXIT_FAILURE;
+            }
+        }
+    }
+    printf("ok, %ld inputs agree, %ld of them parse\n", iterations, parsed);
+    munmap(guarded, guarded_size + page);
+    return 0;
+}
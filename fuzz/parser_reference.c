@@ -0,0 +1,168 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include "parser.h"
+#include "parser_reference.h"
+
+// the parser as it was before the classifier, a byte at a time, kept as
+// the oracle the fuzzers check parse_command against
+
+#define ARENA_ALIGN sizeof(char *)
+
+static size_t align_up(size_t n) {
+    return (n + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+}
+
+// copy a redirection filename to out, quoted or up to the next space
+// returns the end of the copy or NULL if it reaches limit
+static char *copy_filename(const char **curr_ptr, char *out, const char *limit) {
+    const char *curr = *curr_ptr;
+    // move past any extra spaces to reach the filename
+    while (isspace((unsigned char)*curr)) curr++;
+
+    // if the filename is quoted, extract everything within the quotes
+    if (*curr == '"' || *curr == '\'') {
+        char quote_char = *curr++;
+        while (*curr && *curr != quote_char) {
+            if (out == limit) return NULL;
+            *out++ = *curr++;
+        }
+        if (*curr == quote_char) curr++; // skip the closing quote
+    } else {
+        // if not quoted, grab characters until the next space
+        while (*curr && !isspace((unsigned char)*curr)) {
+            if (out == limit) return NULL;
+            *out++ = *curr++;
+        }
+    }
+    if (out == limit) return NULL;
+    *out = '\0';
+    *curr_ptr = curr;
+    return out;
+}
+
+// parse a command exactly like parse_command, without the classifier
+// tokens are written straight into the arena from its front while the argv
+// pointers pile up at its back, once the command is done the argv is moved
+// down behind the strings. a redirection operator is overwritten by its filename
+Command* reference_parse_command(parse_arena_t *arena, const char *input) {
+    size_t mark = arena->used;
+    char *end = arena->base + arena->size;
+    if (arena->size - mark < align_up(sizeof(Command))) {
+        fprintf(stderr, "Error: Command too long.\n");
+        return NULL;
+    }
+    Command *cmd = (Command *)(arena->base + mark);
+    cmd->args = NULL;
+    cmd->input_file = NULL;
+    cmd->output_file = NULL;
+    cmd->error_file = NULL;
+    cmd->pipe_count = 0;
+
+    char *out = (char *)cmd + align_up(sizeof(Command));
+    char **argv_top = (char **)end;    // argv in reverse, growing down
+    const char *curr = input;
+    int in_quotes = 0;
+    char quote_char = '\0';
+    char *token = out;
+
+    // loop through each character in the input until we reach the end
+    while (*curr != '\0') {
+        // check if we hit a quote and it isn't escaped
+        if ((*curr == '"' || *curr == '\'') && (curr == input || *(curr-1) != '\\')) {
+            if (!in_quotes) {
+                in_quotes = 1;
+                quote_char = *curr;
+                curr++;
+                continue;
+            } else if (*curr == quote_char) {
+                in_quotes = 0;
+                curr++;
+                continue;
+            }
+        }
+
+        // if we're inside quotes or encountering non-space characters, build the current token
+        if (in_quotes || !isspace((unsigned char)*curr)) {
+            if (out == (char *)argv_top) goto out_of_room;
+            *out++ = *curr++;
+            continue;
+        }
+
+        // reached a delimiter, so finish processing the token we've built
+        if (out > token) {
+            if (out == (char *)argv_top) goto out_of_room;
+            *out = '\0';
+
+            // check if token is a redirection operator and handle accordingly
+            char **redirect = NULL;
+            if (strcmp(token, "<") == 0) redirect = &cmd->input_file;
+            else if (strcmp(token, ">") == 0) redirect = &cmd->output_file;
+            else if (strcmp(token, "2>") == 0) redirect = &cmd->error_file;
+
+            if (redirect) {
+                out = copy_filename(&curr, token, (char *)argv_top);
+                if (!out) goto out_of_room;
+                *redirect = token;
+                out++;
+            } else if (strcmp(token, "|") == 0) {
+                // found a pipe symbol, so just increase our pipe count for later processing
+                cmd->pipe_count++;
+                out = token;
+            } else {
+                // it's a normal argument, so add it to our list of command arguments
+                if ((char *)(argv_top - 1) < out + 1) goto out_of_room;
+                *--argv_top = token;
+                out++;
+            }
+            token = out;
+        }
+
+        // skip any spaces between tokens to get ready for the next token
+        while (isspace((unsigned char)*curr)) curr++;
+    }
+
+    // if we exit the loop while still inside a quote, that's an error because quotes didn't match
+    if (in_quotes) {
+        fprintf(stderr, "Error: Unmatched quotes.\n");
+        arena->used = mark;
+        return NULL;
+    }
+
+    // if there's any token data left at the end, add it to our command arguments
+    if (out > token) {
+        if (out == (char *)argv_top || (char *)(argv_top - 1) < out + 1) goto out_of_room;
+        *out++ = '\0';
+        *--argv_top = token;
+    }
+
+    // if no arguments were added, then no command was provided, which is an error
+    size_t arg_count = (char **)end - argv_top;
+    if (arg_count == 0) {
+        fprintf(stderr, "Error: No command specified.\n");
+        arena->used = mark;
+        return NULL;
+    }
+
+    // put the arguments back in order and move them behind the strings,
+    // ending with a null pointer for execvp compatibility
+    char **args = (char **)(arena->base + align_up(out - arena->base));
+    if ((char *)(args + arg_count + 1) > end) goto out_of_room;
+    for (size_t i = 0, j = arg_count - 1; i < j; i++, j--) {
+        char *swap = argv_top[i];
+        argv_top[i] = argv_top[j];
+        argv_top[j] = swap;
+    }
+    memmove(args, argv_top, arg_count * sizeof(char *));
+    args[arg_count] = NULL;
+    cmd->args = args;
+    arena->used = (char *)(args + arg_count + 1) - arena->base;
+    return cmd;
+
+out_of_room:
+    fprintf(stderr, "Error: Command too long.\n");
+    arena->used = mark;
+    return NULL;
+}
+
@@ -0,0 +1,9 @@
+#ifndef PARSER_REFERENCE_H
+#define PARSER_REFERENCE_H
+
+#include "parser.h"
+
+// byte at a time parser parse_command must agree with
+Command* reference_parse_command(parse_arena_t *arena, const char *input);
+
+#endif // PARSER_REFERENCE_H
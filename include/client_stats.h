@@ -0,0 +1,48 @@
+#ifndef CLIENT_STATS_H
+#define CLIENT_STATS_H
+
+#include <sys/resource.h>
+
+// most priority levels a client can be pushed down by its cpu usage
+#define CLIENT_MAX_PENALTY 10
+// recent cpu time halves over this long
+#define CLIENT_CPU_HALF_LIFE_MS 10000
+// recent cpu time that costs a client one priority level by default
+#define CLIENT_CPU_PENALTY_DEFAULT_MS 1000
+
+// resources used by the completed tasks of one client
+typedef struct {
+    int tasks;                // tasks completed
+    long long user_us;        // user cpu time of their processes
+    long long sys_us;         // system cpu time of their processes
+    long maxrss_kb;           // largest resident set of any of their processes
+    long nvcsw;               // voluntary context switches
+    long nivcsw;              // involuntary context switches
+    long long wait_ms;        // time the tasks spent waiting in a run queue
+    long long wall_ms;        // time from submission to completion
+    long long recent_cpu_us;  // cpu time decayed by half every CLIENT_CPU_HALF_LIFE_MS
+    long long decayed_ms;     // monotonic time recent_cpu_us was last decayed
+} client_usage_t;
+
+// set how much recent cpu time costs a client a priority level, 0 turns the
+// penalty off. the statistics are kept either way
+void client_stats_init(int penalty_ms);
+
+// add a completed task to its client's totals
+void client_stats_record(int client_id, const struct rusage *usage, long long wait_ms,
+                         long long wall_ms, long long now_ms);
+
+// levels a new task of the client is queued behind others, 0..CLIENT_MAX_PENALTY
+// added to its priority under the priority policy, compared first by the others
+int client_stats_penalty(int client_id, long long now_ms);
+
+// copy a client's totals, returns -1 if none of its tasks completed yet
+int client_stats_get(int client_id, client_usage_t *usage, long long now_ms);
+
+// drop a client's totals once it disconnects
+void client_stats_forget(int client_id);
+
+// drop every client's totals
+void client_stats_cleanup(void);
+
+#endif // CLIENT_STATS_H
@@ -0,0 +1,25 @@
+#ifndef ESTIMATOR_H
+#define ESTIMATOR_H
+
+#include "pipes.h"
+
+// estimate assumed for a command nothing similar has been measured for
+#define ESTIMATE_DEFAULT_MS 100
+
+// estimate execution time for a compiled command in ms, NULL for one that
+// did not parse gets the default
+// commands are grouped by signature: argv[0] followed by their flags and
+// numeric arguments, with every other operand collapsed to "*", so
+// "grep -r foo src" and "grep -r bar include" share their history. the
+// stages of a pipeline are joined by "|". the estimate is an exponentially
+// weighted average of measured run times, falling back to the history of
+// the argv[0]s alone and then to the default
+int estimate_execution_time(const pipeline_plan_t *plan);
+
+// feed a measured run time in ms back into the command's history
+void record_execution_time(const pipeline_plan_t *plan, int elapsed_ms);
+
+// forget all history
+void estimator_cleanup(void);
+
+#endif // ESTIMATOR_H
@@ -1,9 +1,16 @@
 #ifndef EXECUTOR_H
 #define EXECUTOR_H
 
+#include <sys/types.h>
 #include "parser.h"
 
-void execute_command(Command *cmd);
-int handle_builtin_command(Command *cmd);
+// run a command to completion with the given stdin, stdout and stderr
+// descriptors, -1 keeps the server's own. redirections in the command win
+void execute_command(Command *cmd, int in_fd, int out_fd, int err_fd);
+
+// start a command the same way without waiting for it, returns the child pid,
+// 0 for built-ins that already ran, -1 on failure after reporting to err_fd
+pid_t spawn_command(Command *cmd, int in_fd, int out_fd, int err_fd);
+int handle_builtin_command(Command *cmd, int err_fd);
 
 #endif // EXECUTOR_H
@@ -0,0 +1,35 @@
+#ifndef LAUNCHER_H
+#define LAUNCHER_H
+
+#include <sys/types.h>
+#include <sys/resource.h>
+#include "parser.h"
+
+// start the launch helper, a small single-threaded process forked once at
+// boot that spawns commands on the server's behalf, so launching costs the
+// same however large the server grows and no command is ever forked from a
+// process holding client sockets and locks. returns 0, or -1 if commands
+// are spawned from the server itself
+int launcher_start(void);
+
+// shut the helper down, commands started afterwards are spawned in process
+void launcher_stop(void);
+
+// start a command like spawn_command, through the helper while it runs
+// exit_fd gets a close-on-exec descriptor that polls readable once the
+// command has exited, or -1 if launcher_reap has to be polled with WNOHANG.
+// returns the pid, 0 for a builtin and -1 after reporting to err_fd
+pid_t launcher_spawn(Command *cmd, int in_fd, int out_fd, int err_fd, int *exit_fd);
+
+// send a signal to a running command from launcher_spawn, exit_fd is the
+// one it returned. unlike kill on the pid, it never reaches another process
+// once the command has been reaped, by us or by the helper
+void launcher_signal(pid_t pid, int exit_fd, int sig);
+
+// collect the wait status and resource usage of a command from
+// launcher_spawn, options is 0 or WNOHANG. closes *exit_fd and sets it to -1
+// once the command is gone. returns 1 once reaped, 0 if it is still running.
+// status is left alone if the exit was never reported
+int launcher_reap(pid_t pid, int *exit_fd, int options, int *status, struct rusage *usage);
+
+#endif // LAUNCHER_H
@@ -0,0 +1,55 @@
+#ifndef MLFQ_H
+#define MLFQ_H
+
+// tasks are defined in scheduler.h, the queue links them through
+// task->run_prev/run_next and keeps their level in task->level
+struct task;
+
+#define MLFQ_MAX_LEVELS 8
+
+// one priority level, a fifo of waiting tasks
+typedef struct {
+    struct task *head;
+    struct task *tail;
+} mlfq_level_t;
+
+// multi-level feedback queue
+// new tasks start at level 0 (tasks come zeroed from the pool), or lower
+// when the mlfq policy charges their client's cpu penalty. a task that uses
+// its whole slice moves one level down, where slices are longer, and every
+// boost interval all tasks go back to level 0 so long jobs cannot starve. all operations are O(1)
+// apart from picking, which scans at most MLFQ_MAX_LEVELS levels.
+// boosts fall on multiples of the interval on the clock every queue shares,
+// so queues agree on the boosts a task has been through when it moves
+// between them and a stolen task keeps the level it earned
+typedef struct {
+    mlfq_level_t levels[MLFQ_MAX_LEVELS];
+    int level_count;                   // levels in use
+    int quantum_ms[MLFQ_MAX_LEVELS];   // slice length of each level
+    int boost_interval_ms;             // time between priority boosts, 0 = never
+    long long boost_epoch;             // boosts since time 0, the last one applied here
+    int size;                          // waiting tasks
+} mlfq_t;
+
+// set up an empty queue, quanta holds one slice length per level
+void mlfq_init(mlfq_t *mlfq, int level_count, const int *quanta, int boost_interval_ms, long long now_ms);
+
+// add a waiting task at the back of its level
+void mlfq_push(mlfq_t *mlfq, struct task *task);
+
+// the task that would be popped next, or NULL when empty
+struct task *mlfq_peek(const mlfq_t *mlfq);
+
+// remove a waiting task from its level
+void mlfq_remove(mlfq_t *mlfq, struct task *task);
+
+// slice length for a task at its current level
+int mlfq_quantum(const mlfq_t *mlfq, const struct task *task);
+
+// account a finished slice, demoting the task if it used all of it
+void mlfq_charge(mlfq_t *mlfq, struct task *task, int used_ms);
+
+// move every task back to the top level if the boost interval has passed
+void mlfq_boost_if_due(mlfq_t *mlfq, long long now_ms);
+
+#endif // MLFQ_H
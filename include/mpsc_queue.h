@@ -0,0 +1,30 @@
+#ifndef MPSC_QUEUE_H
+#define MPSC_QUEUE_H
+
+// link embedded in whatever is queued
+typedef struct mpsc_node {
+    struct mpsc_node *next;
+} mpsc_node_t;
+
+// intrusive multi-producer single-consumer queue (vyukov)
+// any number of threads may push concurrently, push is wait-free: one atomic
+// exchange and one store. only one thread at a time may pop, callers make
+// sure of that themselves, e.g. by popping under a lock the producers never
+// take. a pop racing a producer that has swung the head but not linked its
+// node yet sees the queue as empty, the node shows up on a later pop
+typedef struct {
+    mpsc_node_t *head;        // most recently pushed node, swapped by producers
+    mpsc_node_t *tail;        // next node to pop, consumer only
+    mpsc_node_t stub;         // keeps the queue non-empty so push never touches tail
+} mpsc_queue_t;
+
+// set up an empty queue
+void mpsc_init(mpsc_queue_t *queue);
+
+// add a node at the back, safe from any thread
+void mpsc_push(mpsc_queue_t *queue, mpsc_node_t *node);
+
+// remove the node at the front, or NULL when empty, consumer only
+mpsc_node_t *mpsc_pop(mpsc_queue_t *queue);
+
+#endif // MPSC_QUEUE_H
@@ -1,6 +1,12 @@
 #ifndef PARSER_H
 #define PARSER_H
 
+#include <stddef.h>
+
+// stack buffer callers parse into before falling back to the heap, fits
+// any command a client can send in one read
+#define PARSE_ARENA_STACK_SIZE 8192
+
 typedef struct Command {
     char **args;           // NULL-terminated array of arguments
     char *input_file;      // input redirection file
@@ -9,7 +15,33 @@ typedef struct Command {
     int pipe_count;        // number of pipes detected n
 } Command;
 
-Command* parse_command(const char *input);
-void free_command(Command *cmd);
+// caller provided memory commands are parsed into, the Command, its argv
+// and every string are carved from it so parsing never allocates
+typedef struct parse_arena {
+    char *base;            // first usable byte, pointer aligned
+    size_t size;           // usable bytes from base
+    size_t used;           // bytes taken by the commands parsed so far
+    void *heap;            // block reserve had to allocate, NULL if none
+} parse_arena_t;
+
+// arena bytes that always suffice to parse an input of this length
+size_t parse_arena_size(size_t input_length);
+
+// use buffer as an empty arena
+void parse_arena_init(parse_arena_t *arena, void *buffer, size_t size);
+
+// use buffer as the arena if it has the needed bytes, a heap block of that
+// size otherwise. returns -1 if the block cannot be allocated
+int parse_arena_reserve(parse_arena_t *arena, void *buffer, size_t size, size_t needed);
+
+// free the heap block reserve allocated, if any
+void parse_arena_release(parse_arena_t *arena);
+
+// parse a command into the arena, returns NULL if it does not parse or the
+// arena is out of room
+Command* parse_command(parse_arena_t *arena, const char *input);
+
+// give the arena back the memory of cmd and of everything parsed after it
+void free_command(parse_arena_t *arena, Command *cmd);
 
 #endif // PARSER_H
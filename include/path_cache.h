@@ -0,0 +1,19 @@
+#ifndef PATH_CACHE_H
+#define PATH_CACHE_H
+
+#include <stddef.h>
+
+// resolve a command name to the executable $PATH would run, into path
+// names are cached, the cache is flushed whenever a $PATH directory gains,
+// loses or renames an entry (watched with inotify). names containing a '/'
+// are not looked up. returns 0 on success, -1 if the caller has to fall back
+// to searching $PATH itself
+int path_cache_resolve(const char *name, char *path, size_t size);
+
+// drop a cached name whose path turned out to be stale
+void path_cache_forget(const char *name);
+
+// free the cache and stop watching $PATH
+void path_cache_cleanup(void);
+
+#endif // PATH_CACHE_H
@@ -1,6 +1,54 @@
 #ifndef PIPES_H
 #define PIPES_H
 
-void execute_pipeline(const char *input);
+#include <sys/types.h>
+#include "parser.h"
+
+// max commands in a pipeline
+#define MAX_COMMANDS 10
+
+// a pipeline parsed once, before any of its stages is started
+// plans are shared between workers through the plan cache and never change
+// after they are compiled, refs keeps one alive while a worker spawns from it
+typedef struct pipeline_plan {
+    char *input;                        // command string the plan was compiled from
+    size_t input_length;                // strlen of input, set once cached
+    unsigned long input_hash;           // hash_input of input, set once cached
+    Command *stages[MAX_COMMANDS];      // argv and redirections of each stage
+    int stage_count;
+    parse_arena_t arena;                // holds the stages, one heap block per plan
+    int refs;                           // holders, the cache counts as one
+    struct pipeline_plan *bucket_next;  // next plan in the same cache bucket
+    struct pipeline_plan *lru_prev;     // neighbours in the cache recency list
+    struct pipeline_plan *lru_next;
+} pipeline_plan_t;
+
+// parse every stage of a pipeline, returns NULL after reporting to err_fd if
+// any stage does not parse. the plan is not cached, release it when done
+pipeline_plan_t *pipeline_plan_compile(const char *input, int err_fd);
+
+// the plan for a command string from the LRU plan cache, compiled on a miss
+// returns a referenced plan the caller releases, or NULL like compile
+pipeline_plan_t *pipeline_plan_get(const char *input, int err_fd);
+void pipeline_plan_release(pipeline_plan_t *plan);
+
+// free every cached plan not currently in use
+void pipeline_cache_cleanup(void);
+
+// start the stages of a plan without waiting for them, the pids of the
+// started stages go to pids and their launcher exit fds to exit_fds (room
+// for MAX_COMMANDS each), reap them with launcher_reap. returns how many
+// stages were started
+int spawn_plan(const pipeline_plan_t *plan, int in_fd, int out_fd, int err_fd, pid_t *pids, int *exit_fds);
+
+// run a pipeline to completion, the first stage reads in_fd and the last
+// writes out_fd, every stage writes errors to err_fd. -1 leaves the
+// server's own descriptor in place
+void execute_pipeline(const char *input, int in_fd, int out_fd, int err_fd);
+
+// start a pipeline through the plan cache without waiting for it, returns
+// how many stages were started, -1 if the pipeline does not parse and
+// nothing was started
+int spawn_pipeline(const char *input, int in_fd, int out_fd, int err_fd, pid_t *pids, int *exit_fds);
 
 #endif // PIPES_H
@@ -1,8 +1,11 @@
 #ifndef REDIRECTION_H
 #define REDIRECTION_H
 
-int redirect_input(const char *filename);
-int redirect_output(const char *filename);
-int redirect_error(const char *filename);
+// open redirection files for a command spawned with posix_spawn, the caller
+// hands the descriptor to the child with a dup2 file action and closes it.
+// return the close-on-exec descriptor, or -1 after reporting to err_fd
+int open_input_redirect(const char *filename, int err_fd);
+int open_output_redirect(const char *filename, int err_fd);
+int open_error_redirect(const char *filename, int err_fd);
 
 #endif // REDIRECTION_H
@@ -0,0 +1,73 @@
+#ifndef RUN_QUEUE_H
+#define RUN_QUEUE_H
+
+#include <pthread.h>
+#include "task_heap.h"
+#include "mlfq.h"
+#include "sched_policy.h"
+#include "mpsc_queue.h"
+
+// tasks and the config are defined in scheduler.h
+struct task;
+struct scheduler_config;
+
+// round robin quanta in milliseconds
+#define FIRST_ROUND_QUANTUM 3000
+#define OTHER_ROUNDS_QUANTUM 7000
+
+// waiting tasks of one worker, ordered by the configured policy
+// every worker owns one run queue and idle workers steal from their peers,
+// so picking a task only contends with the thieves of that one queue.
+// new tasks are submitted through a lock-free intake that whoever holds the
+// lock next drains into the policy in one batch, so submitting never waits
+// for the lock. all functions except init/destroy/submit expect the caller
+// to hold rq->lock
+typedef struct run_queue {
+    pthread_mutex_t lock;          // protects the queue and its tasks' queue state
+    mpsc_queue_t intake;           // submitted tasks not yet ordered by the policy
+    int submitted;                 // tasks in the intake, accessed atomically
+    const sched_policy_t *policy;  // ordering of the waiting tasks
+    task_heap_t shell_tasks;       // waiting shell commands in policy order
+    task_heap_t program_tasks;     // waiting programs in policy order, unless the policy uses levels
+    mlfq_t program_levels;         // waiting programs by feedback level (mlfq)
+    struct task *last_executed;    // most recently started program, to avoid consecutive execution (sjrf)
+    int waiting;                   // tasks in the queue
+} run_queue_t;
+
+// set up an empty run queue, returns 0 on success and -1 on failure
+int run_queue_init(run_queue_t *rq, const struct scheduler_config *config, long long now_ms);
+
+// release the queue storage, the tasks themselves are not freed
+void run_queue_destroy(run_queue_t *rq);
+
+// queue a task as waiting, returns 0 on success and -1 on allocation failure
+int run_queue_push(run_queue_t *rq, struct task *task);
+
+// hand a new task to the queue without holding its lock, wait-free
+void run_queue_submit(run_queue_t *rq, struct task *task);
+
+// move submitted tasks into the policy, returns how many were moved
+int run_queue_drain(run_queue_t *rq);
+
+// waiting and submitted tasks, readable without the lock
+int run_queue_length(run_queue_t *rq);
+
+// take a waiting task out of the queue, does nothing for tasks that are not waiting
+void run_queue_remove(run_queue_t *rq, struct task *task);
+
+// remove and return the task that should run next, or NULL when empty
+struct task *run_queue_pick(run_queue_t *rq, long long now_ms);
+
+// whether task a should preempt the running program b under the queue's policy
+int run_queue_runs_before(const run_queue_t *rq, const struct task *a, const struct task *b);
+
+// quantum length for the next slice of a program, in ms
+int run_queue_quantum(const run_queue_t *rq, const struct task *task);
+
+// account a slice a program just used, in ms
+void run_queue_quantum_end(run_queue_t *rq, struct task *task, int used_ms);
+
+// forget a task that ran from this queue before it is freed
+void run_queue_complete(run_queue_t *rq, struct task *task);
+
+#endif // RUN_QUEUE_H
@@ -0,0 +1,27 @@
+#ifndef SCAN_H
+#define SCAN_H
+
+// byte classes the command scanners stop at, the end of the string always stops
+#define SCAN_SPACE 0x01       // whitespace as isspace sees it in the C locale
+#define SCAN_QUOTE 0x02       // " and '
+#define SCAN_ESCAPE 0x04      // backslash
+#define SCAN_REDIRECT 0x08    // < and >
+#define SCAN_PIPE 0x10        // |
+
+// classifier implementations, the best one the cpu supports is used by default
+#define SCAN_LEVEL_SCALAR 0   // table lookup a byte at a time
+#define SCAN_LEVEL_SSE2 1     // 16 byte blocks
+#define SCAN_LEVEL_AVX2 2     // 32 byte blocks
+#define SCAN_LEVEL_BEST SCAN_LEVEL_AVX2
+
+// the first byte of s in one of the classes, or its terminating NUL
+const char *scan_until(const char *s, unsigned classes);
+
+// switch the classifier, capped at what the cpu supports
+// returns the level in use afterwards
+int scan_set_level(int level);
+
+// name of a classifier level for reports
+const char *scan_level_name(int level);
+
+#endif // SCAN_H
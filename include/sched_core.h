@@ -0,0 +1,65 @@
+#ifndef SCHED_CORE_H
+#define SCHED_CORE_H
+
+// tasks and run queues are defined in scheduler.h and run_queue.h
+struct task;
+struct run_queue;
+
+// shell commands and ended programs a worker relays output for at once
+// while it goes on dispatching
+#define WORKER_MAX_INFLIGHT 16
+
+// what the scheduling decisions need to know about the workers
+// the server backs it with its threads and the monotonic clock, the
+// simulator with virtual workers on a virtual clock, so both make the same
+// placement, stealing, deadline and requeue decisions. workers are numbered
+// 0..worker_count - 1
+typedef struct sched_host {
+    int worker_count;
+    void *ctx;                // passed to every hook
+    // current time in ms
+    long long (*now_ms)(void *ctx);
+    // the worker's run queue
+    struct run_queue *(*queue)(void *ctx, int worker);
+    // whether the worker is waiting for work and would pick a new task right away
+    int (*idle)(void *ctx, int worker);
+    // copy the task the worker runs into copy, returns 0 when it runs none
+    // or was already asked to stop it
+    int (*running)(void *ctx, int worker, struct task *copy);
+    // ask the worker to stop its running program, returns 0 if another
+    // submission asked first
+    int (*preempt)(void *ctx, int worker);
+    // give up on a picked task that can no longer meet its deadline
+    void (*drop)(void *ctx, struct task *task);
+} sched_host_t;
+
+// set the scheduling fields of a new task, including the cpu penalty its
+// client has earned, time_ms is its run time or estimate and deadline_ms how
+// long from now it must finish in, 0 for none
+void sched_prepare_task(struct task *task, int client_id, int type, int time_ms, int priority,
+                        int deadline_ms, long long now_ms);
+
+// the worker a new task should be submitted to. tasks go to their client's
+// home worker unless it is busy and another one is idle. when every worker
+// is busy, the worker running the program the task should beat is asked to
+// stop it and *preempt is set
+int sched_place(const sched_host_t *host, const struct task *task, int *preempt);
+
+// the task a worker should run next, from its own run queue or stolen from
+// the peer with the most waiting, or NULL if there is none. tasks that can
+// no longer meet their deadline are handed to the drop hook instead. takes
+// the run queue locks itself
+struct task *sched_next_task(const sched_host_t *host, int worker);
+
+// length of the next slice of a program, in ms
+int sched_slice_ms(const struct task *task);
+
+// account a slice a program ran for and queue it again if it has time left
+// and was not cancelled. caller holds the lock of task->rq. returns 1 if the
+// task was requeued, 0 if it is done and -1 if there was no room to requeue it
+int sched_quantum_end(struct task *task, int executed_ms, long long now_ms);
+
+// add a finished task to its client's statistics, returns its wall time in ms
+long long sched_record_completion(const struct task *task, long long now_ms);
+
+#endif // SCHED_CORE_H
@@ -0,0 +1,46 @@
+#ifndef SCHED_POLICY_H
+#define SCHED_POLICY_H
+
+// tasks, run queues and the config are defined in scheduler.h and run_queue.h
+struct task;
+struct run_queue;
+struct scheduler_config;
+
+// a scheduling policy, the ordering a run queue keeps its waiting tasks in
+// the run queue owns the task state, counters and locking and calls into its
+// policy for everything that depends on the order. every hook runs with the
+// run queue lock held. on_quantum_end and on_complete may be NULL
+typedef struct sched_policy {
+    int id;                   // SCHED_ALG_* value selecting the policy
+    const char *name;         // name used on the command line
+
+    // set up the policy's structures in an empty run queue, returns 0 on success and -1 on failure
+    int (*init)(struct run_queue *rq, const struct scheduler_config *config, long long now_ms);
+    // release what init set up
+    void (*destroy)(struct run_queue *rq);
+    // add a waiting task, returns 0 on success and -1 on allocation failure
+    int (*enqueue)(struct run_queue *rq, struct task *task);
+    // the waiting task that should run next, still queued, or NULL when empty
+    struct task *(*pick_next)(struct run_queue *rq, long long now_ms);
+    // take a waiting task out of the policy's structures
+    void (*on_remove)(struct run_queue *rq, struct task *task);
+    // quantum length for the next slice of a program, in ms
+    int (*quantum)(const struct run_queue *rq, const struct task *task);
+    // a program used used_ms of its slice and goes back to waiting or completes
+    void (*on_quantum_end)(struct run_queue *rq, struct task *task, int used_ms);
+    // a task that ran from this queue is about to be freed
+    void (*on_complete)(struct run_queue *rq, struct task *task);
+    // whether a newly arrived task should preempt a running program
+    int (*runs_before)(const struct task *a, const struct task *b);
+} sched_policy_t;
+
+// the policy for a SCHED_ALG_* value, falls back to sjrf for unknown values
+const sched_policy_t *sched_policy_get(int id);
+
+// the policy with the given command line name, or NULL if there is none
+const sched_policy_t *sched_policy_find(const char *name);
+
+// names of all policies separated by '|', for usage messages
+const char *sched_policy_names(void);
+
+#endif // SCHED_POLICY_H
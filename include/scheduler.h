@@ -3,6 +3,12 @@
 
 #include <pthread.h>
 #include <time.h>
+#include <sys/types.h>
+#include <sys/resource.h>
+#include "task_pool.h"
+#include "mlfq.h"
+#include "mpsc_queue.h"
+#include "pipes.h"
 
 // task types
 #define TASK_SHELL_COMMAND 1
@@ -12,50 +18,138 @@
 #define TASK_STATE_WAITING 0
 #define TASK_STATE_RUNNING 1
 #define TASK_STATE_COMPLETED 2
+#define TASK_STATE_SUBMITTED 3  // in a run queue's intake, not yet ordered
 
 // scheduler algorithm selection - changed names to avoid conflicts
+// each value names a policy in sched_policy.c
 #define SCHED_ALG_RR 1
 #define SCHED_ALG_SJRF 2
+#define SCHED_ALG_MLFQ 3
+#define SCHED_ALG_FIFO 4
+#define SCHED_ALG_PRIORITY 5
+#define SCHED_ALG_EDF 6
 
-typedef struct {
+// task priorities, lower values run first under the priority policy
+// a task's cpu penalty adds to its priority there and orders it behind less
+// penalized tasks under the other policies
+#define TASK_PRIORITY_MIN -20
+#define TASK_PRIORITY_MAX 19
+
+// what happens to a submission when the queue is at its limit
+#define ADMISSION_REJECT 1    // refuse the task and tell the client
+#define ADMISSION_BLOCK 2     // hold the submitting client until there is room
+
+struct run_queue;
+
+typedef struct task {
     int id;                   // unique task id
     int client_id;            // client that submitted this task
     int client_socket;        // socket to send results back to
     int type;                 // shell command or program
     char *command;            // the command to execute
-    int total_time;           // total execution time (for programs)
-    int remaining_time;       // remaining execution time
+    pipeline_plan_t *plan;    // a shell command's stages from the plan cache, NULL if it did not parse
+    int total_time;           // total execution time in ms, estimated for shell commands
+    int remaining_time;       // remaining execution time in ms
     int state;                // current state of the task
     int round;                // current round number for this task
-    int last_executed;        // flag to avoid consecutive execution
     time_t arrival_time;      // when the task was submitted
     int preempted;            // whether this task was preempted
     size_t bytes_sent;        // bytes sent for this task
+    int copy_output;          // splice failed, output is relayed by copying
+    char *pending;            // output and replies the client socket had no room for yet
+    size_t pending_length;    // bytes waiting in pending
+    int output_blocked;       // the client socket is full, the output pipe is left to the process
+    int replied;              // the task's final prompt was queued
+    int cancelled;            // owner disconnected while the task was running
+    int cancel_replied;       // the cancel builtin already gave the client its prompt
+    int priority;             // TASK_PRIORITY_MIN..MAX, 0 unless the client asked otherwise
+    int penalty;              // levels the client's recent cpu use costs it under every policy
+    long long deadline_ms;    // monotonic time the task must finish by, 0 = none
+    pid_t pid;                // process running a program task, 0 before launch
+    int exit_fd;              // polls readable once the program has exited, -1 if none
+    pid_t stage_pids[MAX_COMMANDS]; // processes of a shell command, one per pipeline stage, 0 once reaped
+    int stage_exit_fds[MAX_COMMANDS]; // exit fds of the stages, -1 where reaping falls back to polling
+    int stage_count;          // stages started
+    long long started_ms;     // monotonic time a shell command was started
+    long long submitted_ms;   // monotonic time the task was accepted
+    long long enqueued_ms;    // monotonic time the task last entered a run queue
+    long long wait_ms;        // time spent waiting in a run queue so far
+    int exit_status;          // wait status of the program or the last stage, -1 until reaped
+    struct rusage usage;      // resources used by the task's processes, summed as they are reaped
+    int output_fd;            // read end of the program's output pipe, -1 if none
+    struct run_queue *rq;     // run queue the task waits in and returns to after a quantum
+    mpsc_node_t intake_node;  // link in the run queue intake while submitted
+    int heap_index;           // slot in the run queue heap, -1 when not queued
+    int level;                // mlfq priority level, 0 is the highest
+    long long boost_epoch;    // mlfq boost the level was last reset in
+    struct task *run_prev;    // neighbours in an mlfq level
+    struct task *run_next;
+    struct task *prev;        // previous task in submission order
+    struct task *next;        // next task in submission order
 } task_t;
 
+// every task the scheduler owns, waiting ones are also in a worker's run queue
+// the lock here only covers creating and freeing tasks, scheduling decisions
+// are made under the per-worker run queue locks
 typedef struct {
-    task_t **tasks;           // array of task pointers
-    int capacity;             // maximum number of tasks
+    task_t *head;             // oldest task, all tasks are linked in submission order
+    task_t *tail;             // newest task
+    task_pool_t pool;         // storage for tasks and their commands
+    int max_tasks;            // admission limit, 0 = unbounded
+    int admission;            // ADMISSION_* policy applied at the limit
     int size;                 // current number of tasks
     int current_round;        // current scheduling round
-    pthread_mutex_t lock;     // mutex to protect the queue
-    pthread_cond_t not_empty; // condition variable for queue not empty
+    pthread_mutex_t lock;     // mutex to protect the task list and pool
+    pthread_cond_t task_done; // signalled whenever a task leaves the queue
+    pthread_cond_t not_full;  // signalled when a blocked submission may proceed
 } task_queue_t;
 
-// initialize the scheduler
-void scheduler_init(void);
+// scheduler settings chosen at startup
+typedef struct scheduler_config {
+    int num_workers;          // executor threads, 0 = one per online cpu
+    int max_tasks;            // queued and running tasks allowed, 0 = unbounded
+    int admission;            // ADMISSION_* policy once max_tasks is reached
+    int algorithm;            // SCHED_ALG_* policy ordering the run queues
+    int mlfq_levels;          // number of mlfq levels
+    int mlfq_quantum_ms[MLFQ_MAX_LEVELS]; // slice length of each mlfq level
+    int mlfq_boost_ms;        // mlfq priority boost interval, 0 = never
+    int cpu_penalty_ms;       // recent cpu time that lowers a client's new tasks one priority level, 0 = never
+} scheduler_config_t;
+
+// fill a config with the default settings
+void scheduler_config_defaults(scheduler_config_t *config);
+
+// parse a comma separated list of mlfq quanta in ms into quanta, which has
+// room for MLFQ_MAX_LEVELS. list is split in place. returns the number of
+// levels, or -1 if a quantum is not positive or there are too many
+int scheduler_parse_quanta(char *list, int *quanta);
+
+// initialize the scheduler, a NULL config selects the defaults
+void scheduler_init(const scheduler_config_t *config);
 
 // clean up the scheduler
 void scheduler_cleanup(void);
 
-// add a task to the queue
-void scheduler_add_task(int client_id, int client_socket, const char *command, int type, int exec_time);
+// add a task to the queue, exec_time is the program run time in seconds and
+// deadline_ms how long from now the task must finish in, 0 for no deadline
+// returns 0 once queued and -1 if the task was refused by admission control
+// or could not be allocated, in which case the caller still owes the client a reply
+int scheduler_add_task(int client_id, int client_socket, const char *command, int type, int exec_time,
+                       int priority, int deadline_ms);
 
-// get the next task to execute based on the scheduling algorithm
-task_t *scheduler_get_next_task(void);
+// cancel one of a client's tasks, a running task is stopped at the end of
+// its quantum. returns 0 if the task existed and -1 otherwise
+int scheduler_cancel_task(int client_id, int task_id);
 
-// update a task's remaining time and status
-void scheduler_update_task(task_t *task, int time_executed);
+// describe a client's tasks into buffer, one per line, returns the number listed
+int scheduler_list_client_tasks(int client_id, char *buffer, size_t size);
+
+// describe the resources used by a client's completed tasks into buffer
+// returns -1 if none of its tasks completed yet
+int scheduler_client_usage(int client_id, char *buffer, size_t size);
+
+// update a task's remaining time and status, time_executed is in ms
+int scheduler_update_task(task_t *task, int time_executed);
 
 // mark a task as completed and remove it from the queue
 void scheduler_complete_task(task_t *task);
@@ -63,15 +157,12 @@ void scheduler_complete_task(task_t *task);
 // remove all tasks for a specific client
 void scheduler_remove_client_tasks(int client_id);
 
-// start the scheduler thread
+// start the executor worker threads
 void scheduler_start(void);
 
-// stop the scheduler thread
+// stop the executor worker threads
 void scheduler_stop(void);
 
-// estimate execution time for a command
-int estimate_execution_time(const char *command);
-
 // demo program execution
 void execute_demo_program(const char *command, int client_socket, int n, int client_id);
 
@@ -1,6 +1,9 @@
 #ifndef SERVER_H
 #define SERVER_H
 
-void start_server(int port);
+#include "scheduler.h"
+
+// start the server, a NULL config runs the scheduler with its defaults
+void start_server(int port, const scheduler_config_t *config);
 
 #endif
\ No newline at end of file
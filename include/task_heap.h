@@ -0,0 +1,42 @@
+#ifndef TASK_HEAP_H
+#define TASK_HEAP_H
+
+// tasks are defined in scheduler.h, the heap only needs their handle slot
+struct task;
+
+// ordering used by a heap, returns non-zero when a must run before b
+typedef int (*task_heap_less_fn)(const struct task *a, const struct task *b);
+
+// binary min-heap of task pointers
+// every task remembers its slot in task->heap_index, so a task can be removed
+// from the middle of the heap by handle in O(log n). a task can only be in one
+// heap at a time
+typedef struct {
+    struct task **items;      // heap ordered array of task pointers
+    int size;                 // current number of tasks
+    int capacity;             // allocated slots, grows on demand
+    task_heap_less_fn less;   // ordering of the heap
+} task_heap_t;
+
+// initialize an empty heap, returns 0 on success and -1 on allocation failure
+int task_heap_init(task_heap_t *heap, task_heap_less_fn less);
+
+// release the heap storage, the tasks themselves are not freed
+void task_heap_destroy(task_heap_t *heap);
+
+// add a task, returns 0 on success and -1 on allocation failure
+int task_heap_push(task_heap_t *heap, struct task *task);
+
+// the task that would be popped next, or NULL when empty
+struct task *task_heap_peek(const task_heap_t *heap);
+
+// the best task other than the one at the top, or NULL if there is none
+struct task *task_heap_runner_up(const task_heap_t *heap);
+
+// remove and return the top task, or NULL when empty
+struct task *task_heap_pop(task_heap_t *heap);
+
+// remove a task from anywhere in the heap, does nothing if it is not queued
+void task_heap_remove(task_heap_t *heap, struct task *task);
+
+#endif // TASK_HEAP_H
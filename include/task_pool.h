@@ -0,0 +1,38 @@
+#ifndef TASK_POOL_H
+#define TASK_POOL_H
+
+#include <stddef.h>
+
+// tasks are defined in scheduler.h
+struct task;
+struct task_slot;
+struct task_slab;
+
+// commands up to this length are stored inside the pool slot itself,
+// longer ones fall back to a separate allocation
+#define TASK_POOL_INLINE_COMMAND 256
+
+// slab allocator for tasks and their command strings
+// slots are carved out of slabs and recycled through a free list, so a
+// task costs no malloc once the pool has grown to the working set size.
+// the pool is not thread safe, the scheduler uses it under its queue lock
+typedef struct {
+    struct task_slot *free_list; // recycled slots ready for reuse
+    struct task_slab *slabs;     // every slab allocated so far
+    size_t slab_count;           // number of slabs
+    size_t in_use;               // slots currently handed out
+} task_pool_t;
+
+// initialize an empty pool
+void task_pool_init(task_pool_t *pool);
+
+// release every slab, tasks still in use become invalid
+void task_pool_destroy(task_pool_t *pool);
+
+// take a zeroed task with a private copy of command, NULL if out of memory
+struct task *task_pool_alloc(task_pool_t *pool, const char *command);
+
+// return a task and its command to the pool
+void task_pool_free(task_pool_t *pool, struct task *task);
+
+#endif // TASK_POOL_H
@@ -0,0 +1,518 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "scheduler.h"
+#include "run_queue.h"
+#include "sched_policy.h"
+#include "sched_core.h"
+#include "client_stats.h"
+
+// deterministic scheduler simulator
+// replays a trace of arrivals through the real run queues and policies on a
+// virtual millisecond clock, and reports throughput, waiting and turnaround
+// times, context switches and per-client fairness. placement, preemption,
+// stealing, deadline drops, requeueing and the cpu penalty are the server's
+// own code in sched_core.c, run against virtual workers. nothing sleeps, so
+// a trace of hours of work replays in milliseconds and always gives the same
+// numbers
+//
+// trace lines are "arrival_ms client_id shell|program burst_ms [priority
+// [deadline_ms]]", '#' starts a comment and the deadline counts from the
+// arrival. shell commands are estimated exactly and run in flight next to
+// their worker, up to WORKER_MAX_INFLIGHT of them, programs run in quanta
+// and hold the worker. every task is charged its burst as cpu time
+
+#define MAX_SIM_WORKERS 64
+#define MAX_SIM_CLIENTS 1024
+
+// one line of a trace
+typedef struct {
+    long long arrival_ms;
+    int client_id;
+    int type;
+    int burst_ms;
+    int priority;
+    int deadline_ms;           // relative to the arrival, 0 = none
+    int line;
+} arrival_t;
+
+// a task being simulated, task comes first so a task_t * is a sim_task_t *
+typedef struct {
+    task_t task;
+    const arrival_t *arrival;
+    long long first_start_ms;  // -1 until first dispatched
+    long long finish_ms;
+    long long done_ms;         // when a shell command in flight ends
+    int dropped;               // picked too late to meet the deadline
+} sim_task_t;
+
+// a virtual executor thread
+typedef struct {
+    run_queue_t rq;
+    sim_task_t *running;       // program holding the worker, NULL if none
+    sim_task_t *last_run;      // task started last
+    long long slice_start_ms;
+    long long slice_end_ms;
+    sim_task_t *inflight[WORKER_MAX_INFLIGHT]; // shell commands running alongside
+    int inflight_count;
+} sim_worker_t;
+
+// results of one replay
+typedef struct {
+    int tasks;                 // completed tasks, the times cover only these
+    int missed;                // tasks dropped or finished after their deadline
+    long long makespan_ms;
+    double avg_wait_ms;
+    long long p99_wait_ms;
+    double avg_turnaround_ms;
+    long long p99_turnaround_ms;
+    int context_switches;
+    int preemptions;
+    double fairness;           // jain's index over per-client mean slowdown, 1 is perfectly fair
+} sim_result_t;
+
+static sim_worker_t workers[MAX_SIM_WORKERS];
+static int worker_count = 1;
+static long long sim_now;      // the virtual clock
+static int completed;          // tasks completed or dropped in the current replay
+static int context_switches;
+static int preemptions;
+static int verbose;
+
+static void print_usage(const char *program_name) {
+    fprintf(stderr, "Usage: %s [-s %s|all] [-w workers] [-m quanta] [-b boost_ms] [-c cpu_ms] [-v] trace...\n",
+            program_name, sched_policy_names());
+    fprintf(stderr, "  -s policy   policy to replay with (default: all)\n");
+    fprintf(stderr, "  -w workers  simulated executor threads (default: 1)\n");
+    fprintf(stderr, "  -m quanta   comma separated mlfq slice per level in ms\n");
+    fprintf(stderr, "  -b boost_ms mlfq priority boost interval in ms\n");
+    fprintf(stderr, "  -c cpu_ms   recent cpu time that queues a client's tasks one level lower, 0 disables it\n");
+    fprintf(stderr, "  -v          also print per-client results\n");
+}
+
+// arrivals in time order, ties in trace order
+static int arrival_cmp(const void *a, const void *b) {
+    const arrival_t *x = a, *y = b;
+    if (x->arrival_ms != y->arrival_ms) return x->arrival_ms < y->arrival_ms ? -1 : 1;
+    return x->line - y->line;
+}
+
+static int long_long_cmp(const void *a, const void *b) {
+    long long x = *(const long long *)a, y = *(const long long *)b;
+    return (x > y) - (x < y);
+}
+
+// read a trace file, returns the number of arrivals or -1 on error
+static int load_trace(const char *path, arrival_t **out) {
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        perror(path);
+        return -1;
+    }
+    int count = 0, capacity = 64, line_number = 0;
+    arrival_t *arrivals = malloc(capacity * sizeof(arrival_t));
+    char line[256];
+    while (arrivals && fgets(line, sizeof(line), file)) {
+        line_number++;
+        char *comment = strchr(line, '#');
+        if (comment) *comment = '\0';
+
+        arrival_t arrival = { .line = line_number };
+        char type[16];
+        int fields = sscanf(line, "%lld %d %15s %d %d %d", &arrival.arrival_ms, &arrival.client_id,
+                            type, &arrival.burst_ms, &arrival.priority, &arrival.deadline_ms);
+        if (fields <= 0) continue;
+        if (fields < 4 || arrival.arrival_ms < 0 || arrival.client_id < 0 ||
+            arrival.client_id >= MAX_SIM_CLIENTS || arrival.burst_ms <= 0 || arrival.deadline_ms < 0) {
+            fprintf(stderr, "%s:%d: malformed arrival\n", path, line_number);
+            goto fail;
+        }
+        if (strcmp(type, "shell") == 0) {
+            arrival.type = TASK_SHELL_COMMAND;
+        } else if (strcmp(type, "program") == 0) {
+            arrival.type = TASK_PROGRAM;
+        } else {
+            fprintf(stderr, "%s:%d: unknown task type %s\n", path, line_number, type);
+            goto fail;
+        }
+
+        if (count == capacity) {
+            capacity *= 2;
+            arrival_t *grown = realloc(arrivals, capacity * sizeof(arrival_t));
+            if (!grown) goto fail;
+            arrivals = grown;
+        }
+        arrivals[count++] = arrival;
+    }
+    if (!arrivals) {
+        perror("malloc");
+        fclose(file);
+        return -1;
+    }
+    fclose(file);
+    qsort(arrivals, count, sizeof(arrival_t), arrival_cmp);
+    *out = arrivals;
+    return count;
+
+fail:
+    free(arrivals);
+    fclose(file);
+    return -1;
+}
+
+// a worker runs a program or waits for work with room for more shell commands
+static int sim_idle(void *ctx, int worker) {
+    (void)ctx;
+    return !workers[worker].running && workers[worker].inflight_count < WORKER_MAX_INFLIGHT;
+}
+
+static long long sim_now_ms(void *ctx) {
+    (void)ctx;
+    return sim_now;
+}
+
+static run_queue_t *sim_queue(void *ctx, int worker) {
+    (void)ctx;
+    return &workers[worker].rq;
+}
+
+static int sim_running(void *ctx, int worker, task_t *copy) {
+    (void)ctx;
+    if (!workers[worker].running) return 0;
+    *copy = workers[worker].running->task;
+    return 1;
+}
+
+// the cpu time a task's processes would have used, for the client statistics
+static void charge_cpu(sim_task_t *task, int used_ms) {
+    long long us = (long long)task->task.usage.ru_utime.tv_sec * 1000000 +
+                   task->task.usage.ru_utime.tv_usec + (long long)used_ms * 1000;
+    task->task.usage.ru_utime.tv_sec = us / 1000000;
+    task->task.usage.ru_utime.tv_usec = us % 1000000;
+}
+
+// a task is done, like scheduler_complete_task
+static void complete_task(sim_task_t *task) {
+    task->task.state = TASK_STATE_COMPLETED;
+    task->finish_ms = sim_now;
+    run_queue_complete(task->task.rq, &task->task);
+    sched_record_completion(&task->task, sim_now);
+    completed++;
+}
+
+static void sim_drop(void *ctx, task_t *task) {
+    (void)ctx;
+    ((sim_task_t *)task)->dropped = 1;
+    complete_task((sim_task_t *)task);
+}
+
+// end the running slice, requeueing or completing the task like scheduler_update_task
+static void end_slice(sim_worker_t *worker) {
+    sim_task_t *task = worker->running;
+    int used_ms = (int)(sim_now - worker->slice_start_ms);
+    worker->running = NULL;
+    charge_cpu(task, used_ms);
+
+    run_queue_t *rq = task->task.rq;
+    pthread_mutex_lock(&rq->lock);
+    int requeued = sched_quantum_end(&task->task, used_ms, sim_now);
+    pthread_mutex_unlock(&rq->lock);
+    if (requeued < 0) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    if (!requeued) complete_task(task);
+}
+
+// the running program is stopped right away, the server stops it as soon as
+// its worker is woken
+static int sim_preempt(void *ctx, int worker) {
+    (void)ctx;
+    end_slice(&workers[worker]);
+    preemptions++;
+    return 1;
+}
+
+// count the start of a task on a worker
+static void note_start(sim_worker_t *worker, sim_task_t *task) {
+    if (worker->last_run != task) context_switches++;
+    if (task->first_start_ms < 0) task->first_start_ms = sim_now;
+    worker->last_run = task;
+}
+
+// finish the shell commands of a worker whose time is up
+static void finish_inflight(sim_worker_t *worker) {
+    for (int i = worker->inflight_count - 1; i >= 0; i--) {
+        sim_task_t *task = worker->inflight[i];
+        if (task->done_ms > sim_now) continue;
+        worker->inflight[i] = worker->inflight[--worker->inflight_count];
+        charge_cpu(task, task->task.remaining_time);
+        task->task.remaining_time = 0;
+        complete_task(task);
+    }
+}
+
+// an arriving task is set up and submitted where the server would put it
+static void place_task(sched_host_t *host, sim_task_t *task) {
+    const arrival_t *arrival = task->arrival;
+    sched_prepare_task(&task->task, arrival->client_id, arrival->type, arrival->burst_ms,
+                       arrival->priority, arrival->deadline_ms, sim_now);
+    int preempt;
+    int target = sched_place(host, &task->task, &preempt);
+    run_queue_submit(&workers[target].rq, &task->task);
+}
+
+// let an idle worker pick until it runs a program, has no room for more
+// shell commands or finds nothing. shell commands run alongside the worker
+// like in the server, programs get one slice
+static void dispatch(const sched_host_t *host, int index) {
+    sim_worker_t *worker = &workers[index];
+    while (sim_idle(NULL, index)) {
+        sim_task_t *task = (sim_task_t *)sched_next_task(host, index);
+        if (!task) return;
+        note_start(worker, task);
+        if (task->task.type == TASK_SHELL_COMMAND) {
+            task->done_ms = sim_now + task->task.remaining_time;
+            worker->inflight[worker->inflight_count++] = task;
+            continue;
+        }
+        int slice_ms = sched_slice_ms(&task->task);
+        worker->running = task;
+        worker->slice_start_ms = sim_now;
+        worker->slice_end_ms = sim_now + (slice_ms < 1 ? 1 : slice_ms);
+    }
+}
+
+// p99 of a sorted array
+static long long percentile_99(const long long *sorted, int count) {
+    int index = (int)((count - 1) * 0.99 + 0.5);
+    return sorted[index];
+}
+
+// compute the results of a finished replay
+static void summarize(const sim_task_t *tasks, int count, sim_result_t *result) {
+    long long *waits = malloc(count * sizeof(long long));
+    long long *turnarounds = malloc(count * sizeof(long long));
+    double *slowdown_sum = calloc(MAX_SIM_CLIENTS, sizeof(double));
+    int *client_tasks = calloc(MAX_SIM_CLIENTS, sizeof(int));
+    if (!waits || !turnarounds || !slowdown_sum || !client_tasks) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+
+    double wait_sum = 0, turnaround_sum = 0;
+    long long first_arrival = tasks[0].arrival->arrival_ms, last_finish = first_arrival;
+    int finished = 0, missed = 0;
+    for (int i = 0; i < count; i++) {
+        const arrival_t *arrival = tasks[i].arrival;
+        long long turnaround = tasks[i].finish_ms - arrival->arrival_ms;
+        if (tasks[i].dropped || (arrival->deadline_ms > 0 && turnaround > arrival->deadline_ms)) missed++;
+        if (tasks[i].dropped) continue;
+
+        turnarounds[finished] = turnaround;
+        waits[finished] = turnaround - arrival->burst_ms;
+        wait_sum += waits[finished];
+        turnaround_sum += turnaround;
+        finished++;
+        if (tasks[i].finish_ms > last_finish) last_finish = tasks[i].finish_ms;
+        slowdown_sum[arrival->client_id] += (double)turnaround / arrival->burst_ms;
+        client_tasks[arrival->client_id]++;
+    }
+    qsort(waits, finished, sizeof(long long), long_long_cmp);
+    qsort(turnarounds, finished, sizeof(long long), long_long_cmp);
+
+    // jain's fairness index over the clients' mean slowdowns
+    double sum = 0, sum_squares = 0;
+    int clients = 0;
+    for (int c = 0; c < MAX_SIM_CLIENTS; c++) {
+        if (client_tasks[c] == 0) continue;
+        double slowdown = slowdown_sum[c] / client_tasks[c];
+        sum += slowdown;
+        sum_squares += slowdown * slowdown;
+        clients++;
+        if (verbose) {
+            printf("    client %-4d tasks %-5d mean slowdown %.2f\n", c, client_tasks[c], slowdown);
+        }
+    }
+
+    result->tasks = finished;
+    result->missed = missed;
+    result->makespan_ms = last_finish - first_arrival;
+    result->avg_wait_ms = finished ? wait_sum / finished : 0;
+    result->p99_wait_ms = finished ? percentile_99(waits, finished) : 0;
+    result->avg_turnaround_ms = finished ? turnaround_sum / finished : 0;
+    result->p99_turnaround_ms = finished ? percentile_99(turnarounds, finished) : 0;
+    result->context_switches = context_switches;
+    result->preemptions = preemptions;
+    result->fairness = sum_squares > 0 ? (sum * sum) / (clients * sum_squares) : 1.0;
+
+    free(waits);
+    free(turnarounds);
+    free(slowdown_sum);
+    free(client_tasks);
+}
+
+// replay a trace with one policy
+static void replay(const arrival_t *arrivals, int count, const scheduler_config_t *config,
+                   sim_result_t *result) {
+    sim_task_t *tasks = calloc(count, sizeof(sim_task_t));
+    if (!tasks) {
+        perror("calloc");
+        exit(EXIT_FAILURE);
+    }
+    // the other fields are set by sched_prepare_task on arrival
+    for (int i = 0; i < count; i++) {
+        tasks[i].arrival = &arrivals[i];
+        tasks[i].task.id = i + 1;
+        tasks[i].task.output_fd = -1;
+        tasks[i].task.exit_status = -1;
+        tasks[i].first_start_ms = -1;
+    }
+
+    sim_now = arrivals[0].arrival_ms;
+    for (int i = 0; i < worker_count; i++) {
+        memset(&workers[i], 0, sizeof(sim_worker_t));
+        if (run_queue_init(&workers[i].rq, config, sim_now) != 0) {
+            perror("run queue init failed");
+            exit(EXIT_FAILURE);
+        }
+    }
+    sched_host_t host = { worker_count, NULL, sim_now_ms, sim_queue, sim_idle, sim_running,
+                          sim_preempt, sim_drop };
+    client_stats_init(config->cpu_penalty_ms);
+    completed = 0;
+    context_switches = 0;
+    preemptions = 0;
+
+    int next_arrival = 0;
+    while (completed < count) {
+        // slices and shell commands ending now, then arrivals, then idle workers pick
+        for (int i = 0; i < worker_count; i++) {
+            if (workers[i].running && workers[i].slice_end_ms <= sim_now) end_slice(&workers[i]);
+            finish_inflight(&workers[i]);
+        }
+        while (next_arrival < count && arrivals[next_arrival].arrival_ms <= sim_now) {
+            place_task(&host, &tasks[next_arrival]);
+            next_arrival++;
+        }
+        for (int i = 0; i < worker_count; i++) {
+            dispatch(&host, i);
+        }
+
+        // advance the clock to the next event
+        long long next_ms = LLONG_MAX;
+        if (next_arrival < count) next_ms = arrivals[next_arrival].arrival_ms;
+        for (int i = 0; i < worker_count; i++) {
+            if (workers[i].running && workers[i].slice_end_ms < next_ms) next_ms = workers[i].slice_end_ms;
+            for (int j = 0; j < workers[i].inflight_count; j++) {
+                if (workers[i].inflight[j]->done_ms < next_ms) next_ms = workers[i].inflight[j]->done_ms;
+            }
+        }
+        if (next_ms == LLONG_MAX) break;
+        sim_now = next_ms;
+    }
+
+    summarize(tasks, count, result);
+    for (int i = 0; i < worker_count; i++) {
+        run_queue_destroy(&workers[i].rq);
+    }
+    client_stats_cleanup();
+    free(tasks);
+}
+
+static void print_result(const char *policy, const sim_result_t *result) {
+    double throughput = result->makespan_ms > 0 ? result->tasks * 1000.0 / result->makespan_ms : 0;
+    printf("  %-9s %9.3f/s %10.0f %10lld %10.0f %10lld %9d %8d %7d %8.3f\n", policy, throughput,
+           result->avg_wait_ms, result->p99_wait_ms, result->avg_turnaround_ms,
+           result->p99_turnaround_ms, result->context_switches, result->preemptions, result->missed,
+           result->fairness);
+}
+
+int main(int argc, char *argv[]) {
+    scheduler_config_t config;
+    scheduler_config_defaults(&config);
+    const sched_policy_t *only_policy = NULL;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "s:w:m:b:c:vh")) != -1) {
+        switch (opt) {
+        case 's':
+            if (strcmp(optarg, "all") == 0) {
+                only_policy = NULL;
+            } else if (!(only_policy = sched_policy_find(optarg))) {
+                fprintf(stderr, "Unknown scheduling algorithm: %s\n", optarg);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'w':
+            worker_count = atoi(optarg);
+            if (worker_count <= 0 || worker_count > MAX_SIM_WORKERS) {
+                fprintf(stderr, "Worker count must be between 1 and %d.\n", MAX_SIM_WORKERS);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'm':
+            config.mlfq_levels = scheduler_parse_quanta(optarg, config.mlfq_quantum_ms);
+            if (config.mlfq_levels < 0) {
+                fprintf(stderr, "Invalid mlfq quanta, expected up to %d positive values.\n", MLFQ_MAX_LEVELS);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'b':
+            config.mlfq_boost_ms = atoi(optarg);
+            if (config.mlfq_boost_ms < 0) config.mlfq_boost_ms = 0;
+            break;
+        case 'c':
+            config.cpu_penalty_ms = atoi(optarg);
+            if (config.cpu_penalty_ms < 0) config.cpu_penalty_ms = 0;
+            break;
+        case 'v':
+            verbose = 1;
+            break;
+        default:
+            print_usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (optind == argc) {
+        print_usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    // the policies in the order sched_policy_names lists them
+    char names[128];
+    snprintf(names, sizeof(names), "%s", sched_policy_names());
+
+    int status = EXIT_SUCCESS;
+    for (int t = optind; t < argc; t++) {
+        arrival_t *arrivals;
+        int count = load_trace(argv[t], &arrivals);
+        if (count <= 0) {
+            if (count == 0) fprintf(stderr, "%s: empty trace\n", argv[t]);
+            status = EXIT_FAILURE;
+            continue;
+        }
+
+        printf("%s: %d tasks, %d worker(s)\n", argv[t], count, worker_count);
+        printf("  %-9s %11s %10s %10s %10s %10s %9s %8s %7s %8s\n", "policy", "throughput",
+               "avg wait", "p99 wait", "avg turn", "p99 turn", "switches", "preempt", "missed", "fairness");
+        char list[128];
+        memcpy(list, names, sizeof(list));
+        for (char *name = strtok(list, "|"); name; name = strtok(NULL, "|")) {
+            const sched_policy_t *policy = sched_policy_find(name);
+            if (only_policy && policy != only_policy) continue;
+            config.algorithm = policy->id;
+
+            sim_result_t result;
+            if (verbose) printf("  %s\n", name);
+            replay(arrivals, count, &config, &result);
+            print_result(name, &result);
+        }
+        free(arrivals);
+    }
+    return status;
+}
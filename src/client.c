@@ -14,6 +14,33 @@
 #define MAX_INPUT_SIZE 1024
 #define MAX_OUTPUT_SIZE 4096 // maximum size of output buffer
 
+// send a line typed at the prompt, returns whether a reply ending in the
+// prompt is now awaited
+static int submit_line(int client_socket, const char *input) {
+    // check if user wants to exit
+    if (strcmp(input, "exit") == 0) {
+        // send exit command to server
+        send(client_socket, input, strlen(input), 0);
+        return 1;  // Wait for the server's goodbye message
+    }
+    
+    if (strlen(input) == 0) {
+        // Skip empty input, but still show the prompt
+        printf("$ ");
+        fflush(stdout);
+        return 0;
+    }
+    
+    // send command to server
+    if (send(client_socket, input, strlen(input), 0) < 0) {
+        perror("send");
+        return 0;
+    }
+    
+    // After sending a command, we're waiting for a response (which should end with a prompt)
+    return 1;
+}
+
 void start_client(const char *ip, int port) {
     // create socket variables
     int client_socket;
@@ -55,10 +82,12 @@ void start_client(const char *ip, int port) {
     char input[MAX_INPUT_SIZE];
     char output[MAX_OUTPUT_SIZE];
     int waiting_for_prompt = 1;  // Start by waiting for the first prompt
+    char queued[MAX_INPUT_SIZE];  // a line typed while waiting, sent at the prompt
+    int has_queued = 0;
     
     while (1) {
         FD_ZERO(&read_fds);
-        FD_SET(STDIN_FILENO, &read_fds);
+        if (!has_queued) FD_SET(STDIN_FILENO, &read_fds);
         FD_SET(client_socket, &read_fds);
         
         // wait for input from either stdin or the server
@@ -94,6 +123,10 @@ void start_client(const char *ip, int port) {
                 printf("$ ");
                 fflush(stdout);
                 waiting_for_prompt = 0;
+                if (has_queued) {
+                    has_queued = 0;
+                    waiting_for_prompt = submit_line(client_socket, queued);
+                }
             } else {
                 // Just print the output as-is
                 printf("%s", output);
@@ -101,8 +134,10 @@ void start_client(const char *ip, int port) {
             }
         }
         
-        // check for input from stdin (only if we're not waiting for a prompt)
-        if (FD_ISSET(STDIN_FILENO, &read_fds) && !waiting_for_prompt) {
+        // check for input from stdin. while a command runs, "cancel <id>" with
+        // the id its "[task <id>]" line gave goes out right away, any other
+        // line waits for the prompt
+        if (FD_ISSET(STDIN_FILENO, &read_fds)) {
             if (!fgets(input, sizeof(input), stdin)) {
                 break;
             }
@@ -110,29 +145,14 @@ void start_client(const char *ip, int port) {
             // remove trailing newline
             input[strcspn(input, "\n")] = 0;
             
-            // check if user wants to exit
-            if (strcmp(input, "exit") == 0) {
-                // send exit command to server
-                send(client_socket, input, strlen(input), 0);
-                waiting_for_prompt = 1;  // Wait for the server's goodbye message
-                continue;
-            }
-            
-            if (strlen(input) == 0) {
-                // Skip empty input, but still show the prompt
-                printf("$ ");
-                fflush(stdout);
-                continue;
-            }
-            
-            // send command to server
-            if (send(client_socket, input, strlen(input), 0) < 0) {
-                perror("send");
-                continue;
+            if (!waiting_for_prompt) {
+                waiting_for_prompt = submit_line(client_socket, input);
+            } else if (strncmp(input, "cancel ", 7) == 0) {
+                if (send(client_socket, input, strlen(input), 0) < 0) perror("send");
+            } else {
+                memcpy(queued, input, sizeof(queued));
+                has_queued = 1;
             }
-            
-            // After sending a command, we're waiting for a response (which should end with a prompt)
-            waiting_for_prompt = 1;
         }
     }
     
@@ -6,7 +6,13 @@
 #define DEFAULT_PORT 8080
 #define DEFAULT_IP "127.0.0.1"
 
-int main(void) {
-    start_client(DEFAULT_IP, DEFAULT_PORT);
+int main(int argc, char *argv[]) {
+    // the port is optional, for servers started with -p
+    int port = argc > 1 ? atoi(argv[1]) : DEFAULT_PORT;
+    if (port <= 0 || port > 65535) {
+        fprintf(stderr, "Invalid port number. Using default port %d.\n", DEFAULT_PORT);
+        port = DEFAULT_PORT;
+    }
+    start_client(DEFAULT_IP, port);
     return 0;
 }
\ No newline at end of file
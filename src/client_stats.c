@@ -0,0 +1,132 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdlib.h>
+#include <pthread.h>
+#include "client_stats.h"
+
+#define CLIENT_STATS_BUCKETS 256
+
+typedef struct client_entry {
+    int client_id;
+    client_usage_t usage;
+    struct client_entry *next;    // next entry in the same bucket
+} client_entry;
+
+static client_entry *buckets[CLIENT_STATS_BUCKETS];
+static int penalty_step_us = CLIENT_CPU_PENALTY_DEFAULT_MS * 1000;
+static pthread_mutex_t client_stats_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static unsigned bucket_of(int client_id) {
+    return (unsigned)client_id % CLIENT_STATS_BUCKETS;
+}
+
+// find a client's entry, caller holds the stats lock
+static client_entry *find_entry(int client_id) {
+    for (client_entry *entry = buckets[bucket_of(client_id)]; entry; entry = entry->next) {
+        if (entry->client_id == client_id) return entry;
+    }
+    return NULL;
+}
+
+// age the recent cpu time up to now, caller holds the stats lock
+// whole half lives halve it, the rest of the interval is interpolated linearly
+static void decay(client_usage_t *usage, long long now_ms) {
+    long long elapsed = now_ms - usage->decayed_ms;
+    if (elapsed <= 0) return;
+    long long halvings = elapsed / CLIENT_CPU_HALF_LIFE_MS;
+    long long rest = elapsed % CLIENT_CPU_HALF_LIFE_MS;
+    long long recent = halvings >= 63 ? 0 : usage->recent_cpu_us >> halvings;
+    recent -= recent * rest / (2 * CLIENT_CPU_HALF_LIFE_MS);
+    usage->recent_cpu_us = recent;
+    usage->decayed_ms = now_ms;
+}
+
+static long long timeval_us(struct timeval tv) {
+    return (long long)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+void client_stats_init(int penalty_ms) {
+    pthread_mutex_lock(&client_stats_lock);
+    penalty_step_us = penalty_ms > 0 ? penalty_ms * 1000 : 0;
+    pthread_mutex_unlock(&client_stats_lock);
+}
+
+void client_stats_record(int client_id, const struct rusage *usage, long long wait_ms,
+                         long long wall_ms, long long now_ms) {
+    pthread_mutex_lock(&client_stats_lock);
+    client_entry *entry = find_entry(client_id);
+    if (!entry) {
+        entry = calloc(1, sizeof(client_entry));
+        if (!entry) {
+            pthread_mutex_unlock(&client_stats_lock);
+            return;
+        }
+        entry->client_id = client_id;
+        entry->usage.decayed_ms = now_ms;
+        unsigned bucket = bucket_of(client_id);
+        entry->next = buckets[bucket];
+        buckets[bucket] = entry;
+    }
+    client_usage_t *total = &entry->usage;
+    long long cpu_us = timeval_us(usage->ru_utime) + timeval_us(usage->ru_stime);
+    total->tasks++;
+    total->user_us += timeval_us(usage->ru_utime);
+    total->sys_us += timeval_us(usage->ru_stime);
+    if (usage->ru_maxrss > total->maxrss_kb) total->maxrss_kb = usage->ru_maxrss;
+    total->nvcsw += usage->ru_nvcsw;
+    total->nivcsw += usage->ru_nivcsw;
+    total->wait_ms += wait_ms;
+    total->wall_ms += wall_ms;
+    decay(total, now_ms);
+    total->recent_cpu_us += cpu_us;
+    pthread_mutex_unlock(&client_stats_lock);
+}
+
+int client_stats_penalty(int client_id, long long now_ms) {
+    int penalty = 0;
+    pthread_mutex_lock(&client_stats_lock);
+    client_entry *entry = find_entry(client_id);
+    if (entry && penalty_step_us > 0) {
+        decay(&entry->usage, now_ms);
+        long long levels = entry->usage.recent_cpu_us / penalty_step_us;
+        penalty = levels > CLIENT_MAX_PENALTY ? CLIENT_MAX_PENALTY : (int)levels;
+    }
+    pthread_mutex_unlock(&client_stats_lock);
+    return penalty;
+}
+
+int client_stats_get(int client_id, client_usage_t *usage, long long now_ms) {
+    pthread_mutex_lock(&client_stats_lock);
+    client_entry *entry = find_entry(client_id);
+    if (entry) {
+        decay(&entry->usage, now_ms);
+        *usage = entry->usage;
+    }
+    pthread_mutex_unlock(&client_stats_lock);
+    return entry ? 0 : -1;
+}
+
+void client_stats_forget(int client_id) {
+    pthread_mutex_lock(&client_stats_lock);
+    client_entry **link = &buckets[bucket_of(client_id)];
+    while (*link && (*link)->client_id != client_id) link = &(*link)->next;
+    if (*link) {
+        client_entry *entry = *link;
+        *link = entry->next;
+        free(entry);
+    }
+    pthread_mutex_unlock(&client_stats_lock);
+}
+
+void client_stats_cleanup(void) {
+    pthread_mutex_lock(&client_stats_lock);
+    for (int i = 0; i < CLIENT_STATS_BUCKETS; i++) {
+        client_entry *entry = buckets[i];
+        while (entry) {
+            client_entry *next = entry->next;
+            free(entry);
+            entry = next;
+        }
+        buckets[i] = NULL;
+    }
+    pthread_mutex_unlock(&client_stats_lock);
+}
@@ -0,0 +1,142 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <pthread.h>
+#include "estimator.h"
+#include "parser.h"
+
+#define ESTIMATOR_BUCKETS 1024
+#define ESTIMATOR_MAX_ENTRIES 4096
+#define MAX_SIGNATURE 256
+// weight of the newest measurement, in percent
+#define EWMA_WEIGHT 50
+
+typedef struct history_entry {
+    char *signature;
+    int average_ms;               // weighted average of the measured run times
+    struct history_entry *next;   // next entry in the same bucket
+} history_entry;
+
+static history_entry *buckets[ESTIMATOR_BUCKETS];
+static int entry_count = 0;
+static pthread_mutex_t estimator_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// djb2 string hash
+static unsigned long hash_signature(const char *signature) {
+    unsigned long hash = 5381;
+    for (const unsigned char *c = (const unsigned char *)signature; *c; c++) {
+        hash = hash * 33 + *c;
+    }
+    return hash % ESTIMATOR_BUCKETS;
+}
+
+static int is_number(const char *arg) {
+    if (*arg == '\0') return 0;
+    for (; *arg; arg++) {
+        if (!isdigit((unsigned char)*arg)) return 0;
+    }
+    return 1;
+}
+
+// append a word to a signature, truncating instead of overflowing
+static void append_word(char *signature, const char *word) {
+    size_t used = strlen(signature);
+    if (used > 0 && used < MAX_SIGNATURE - 1) signature[used++] = ' ';
+    snprintf(signature + used, MAX_SIGNATURE - used, "%s", word);
+}
+
+// build the full signature and the argv[0] one from the stages the command
+// was already parsed into
+static void build_signatures(const pipeline_plan_t *plan, char *full, char *name) {
+    full[0] = '\0';
+    name[0] = '\0';
+    for (int stage = 0; stage < plan->stage_count; stage++) {
+        const Command *cmd = plan->stages[stage];
+        if (stage > 0) {
+            append_word(name, "|");
+            append_word(full, "|");
+        }
+        append_word(name, cmd->args[0]);
+        append_word(full, cmd->args[0]);
+        for (int i = 1; cmd->args[i]; i++) {
+            const char *arg = cmd->args[i];
+            append_word(full, (arg[0] == '-' || is_number(arg)) ? arg : "*");
+        }
+    }
+}
+
+// find the history for a signature, caller holds the estimator lock
+static history_entry *find_entry(const char *signature) {
+    for (history_entry *entry = buckets[hash_signature(signature)]; entry; entry = entry->next) {
+        if (strcmp(entry->signature, signature) == 0) return entry;
+    }
+    return NULL;
+}
+
+// fold a measurement into a signature's history, caller holds the estimator lock
+static void update_entry(const char *signature, int elapsed_ms) {
+    history_entry *entry = find_entry(signature);
+    if (entry) {
+        entry->average_ms = (EWMA_WEIGHT * elapsed_ms + (100 - EWMA_WEIGHT) * entry->average_ms) / 100;
+        return;
+    }
+    // the table stops learning new signatures once it is full
+    if (entry_count >= ESTIMATOR_MAX_ENTRIES) return;
+    
+    entry = malloc(sizeof(history_entry));
+    if (!entry) return;
+    entry->signature = strdup(signature);
+    if (!entry->signature) {
+        free(entry);
+        return;
+    }
+    entry->average_ms = elapsed_ms;
+    unsigned long bucket = hash_signature(signature);
+    entry->next = buckets[bucket];
+    buckets[bucket] = entry;
+    entry_count++;
+}
+
+int estimate_execution_time(const pipeline_plan_t *plan) {
+    char full[MAX_SIGNATURE], name[MAX_SIGNATURE];
+    if (!plan) return ESTIMATE_DEFAULT_MS;
+    build_signatures(plan, full, name);
+    
+    pthread_mutex_lock(&estimator_lock);
+    history_entry *entry = find_entry(full);
+    if (!entry) entry = find_entry(name);
+    int estimate = entry ? entry->average_ms : ESTIMATE_DEFAULT_MS;
+    pthread_mutex_unlock(&estimator_lock);
+    
+    // a zero estimate would tie with finished work, keep it positive
+    return estimate > 0 ? estimate : 1;
+}
+
+void record_execution_time(const pipeline_plan_t *plan, int elapsed_ms) {
+    char full[MAX_SIGNATURE], name[MAX_SIGNATURE];
+    if (!plan || elapsed_ms < 0) return;
+    build_signatures(plan, full, name);
+    
+    pthread_mutex_lock(&estimator_lock);
+    update_entry(full, elapsed_ms);
+    if (strcmp(full, name) != 0) update_entry(name, elapsed_ms);
+    pthread_mutex_unlock(&estimator_lock);
+}
+
+void estimator_cleanup(void) {
+    pthread_mutex_lock(&estimator_lock);
+    for (int i = 0; i < ESTIMATOR_BUCKETS; i++) {
+        history_entry *entry = buckets[i];
+        while (entry) {
+            history_entry *next = entry->next;
+            free(entry->signature);
+            free(entry);
+            entry = next;
+        }
+        buckets[i] = NULL;
+    }
+    entry_count = 0;
+    pthread_mutex_unlock(&estimator_lock);
+}
@@ -1,57 +1,105 @@
+#define _POSIX_C_SOURCE 200809L
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
 #include <sys/wait.h>
 #include <errno.h>
 #include <string.h>
+#include <signal.h>
+#include <spawn.h>
+#include <limits.h>
 #include "executor.h"
 #include "redirection.h"
+#include "path_cache.h"
 
 #define COLOR_GREEN "\033[1;32m"
 
-void execute_command(Command *cmd) {
-    // check if the command is a built-in command
-    if (handle_builtin_command(cmd)) {
-        return;
+extern char **environ;
+
+void execute_command(Command *cmd, int in_fd, int out_fd, int err_fd) {
+    pid_t pid = spawn_command(cmd, in_fd, out_fd, err_fd);
+    if (pid > 0) {
+        // wait for the child to finish
+        int status;
+        waitpid(pid, &status, 0);
     }
-    pid_t pid = fork();
-    if (pid < 0) {
-        perror("fork");
-        return;
+}
+
+// start a command without waiting for it
+// the descriptors and redirections are applied as posix_spawn file actions,
+// so only the child sees them and any number of commands can be started
+// concurrently without touching the server's own stdin/stdout/stderr
+pid_t spawn_command(Command *cmd, int in_fd, int out_fd, int err_fd) {
+    int report_fd = err_fd >= 0 ? err_fd : STDERR_FILENO;
+
+    // check if the command is a built-in command
+    if (handle_builtin_command(cmd, report_fd)) {
+        return 0;
     }
-    if (pid == 0) {
-        // child process: set up redirections if specified
-        if (cmd->input_file) {
-            if (redirect_input(cmd->input_file) != 0)
-                exit(EXIT_FAILURE);
-        }
-        if (cmd->output_file) { // redirect output to a file
-            if (redirect_output(cmd->output_file) != 0)
-                exit(EXIT_FAILURE);
+
+    // redirection files replace the descriptors the caller passed
+    int redirect_fds[3] = { -1, -1, -1 };
+    if ((cmd->input_file && (redirect_fds[0] = open_input_redirect(cmd->input_file, report_fd)) < 0) ||
+        (cmd->output_file && (redirect_fds[1] = open_output_redirect(cmd->output_file, report_fd)) < 0) ||
+        (cmd->error_file && (redirect_fds[2] = open_error_redirect(cmd->error_file, report_fd)) < 0)) {
+        for (int i = 0; i < 3; i++) {
+            if (redirect_fds[i] >= 0) close(redirect_fds[i]);
         }
-        if (cmd->error_file) { // redirect error output to a file
-            if (redirect_error(cmd->error_file) != 0)
-                exit(EXIT_FAILURE);
+        return -1;
+    }
+    int child_fds[3] = { in_fd, out_fd, err_fd };
+
+    posix_spawn_file_actions_t actions;
+    posix_spawnattr_t attr;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawnattr_init(&attr);
+    for (int i = 0; i < 3; i++) {
+        if (redirect_fds[i] >= 0) child_fds[i] = redirect_fds[i];
+        if (child_fds[i] >= 0 && child_fds[i] != i) {
+            posix_spawn_file_actions_adddup2(&actions, child_fds[i], i);
         }
-        if (execvp(cmd->args[0], cmd->args) < 0) {
-            // execvp only returns if an error occurs
-            if (errno == ENOENT) { // command not found
-                fprintf(stderr, "Command not found: \"" COLOR_GREEN "%s" "\033[0m" "\"\n", cmd->args[0]);
-            } else {
-                perror("execvp");
-            }
-            free_command(cmd);
-            exit(EXIT_FAILURE);
+    }
+    // the server ignores SIGPIPE and its threads may block signals, commands
+    // start with the defaults
+    sigset_t default_signals, empty_mask;
+    sigemptyset(&default_signals);
+    sigaddset(&default_signals, SIGPIPE);
+    sigemptyset(&empty_mask);
+    posix_spawnattr_setsigdefault(&attr, &default_signals);
+    posix_spawnattr_setsigmask(&attr, &empty_mask);
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGDEF | POSIX_SPAWN_SETSIGMASK);
+
+    // exec the cached path directly instead of letting posix_spawnp try every
+    // $PATH directory, a path gone stale is forgotten and searched for again
+    pid_t pid;
+    char path[PATH_MAX];
+    int error = ENOENT;
+    if (path_cache_resolve(cmd->args[0], path, sizeof(path)) == 0) {
+        error = posix_spawn(&pid, path, &actions, &attr, cmd->args, environ);
+        if (error == ENOENT) path_cache_forget(cmd->args[0]);
+    }
+    if (error == ENOENT) {
+        error = posix_spawnp(&pid, cmd->args[0], &actions, &attr, cmd->args, environ);
+    }
+
+    posix_spawn_file_actions_destroy(&actions);
+    posix_spawnattr_destroy(&attr);
+    for (int i = 0; i < 3; i++) {
+        if (redirect_fds[i] >= 0) close(redirect_fds[i]);
+    }
+    if (error != 0) {
+        if (error == ENOENT) { // command not found
+            dprintf(report_fd, "Command not found: \"" COLOR_GREEN "%s" "\033[0m" "\"\n", cmd->args[0]);
+        } else {
+            dprintf(report_fd, "posix_spawn: %s\n", strerror(error));
         }
-    } else {
-        // parent process: wait for the child to finish
-        int status;
-        waitpid(pid, &status, 0);
+        return -1;
     }
+    return pid;
 }
 
 // handle built-in commands
-int handle_builtin_command(Command *cmd) {
+int handle_builtin_command(Command *cmd, int err_fd) {
     if (strcmp(cmd->args[0], "cd") == 0) {
         // Change directory
         if (cmd->args[1] == NULL) {
@@ -59,10 +107,10 @@ int handle_builtin_command(Command *cmd) {
             chdir(getenv("HOME"));
         } else {
             if (chdir(cmd->args[1]) != 0) {
-                perror("cd");
+                dprintf(err_fd, "cd: %s\n", strerror(errno));
             }
         }
         return 1; // Command was handled
     }
     return 0; // Not a built-in command
-}
\ No newline at end of file
+}
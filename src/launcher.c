@@ -0,0 +1,460 @@
+#define _GNU_SOURCE  // pipe2, signalfd, MSG_CMSG_CLOEXEC
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <limits.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <sys/signalfd.h>
+#include <sys/syscall.h>
+#include "launcher.h"
+#include "executor.h"
+
+// largest request, longer commands are spawned in process
+#define LAUNCH_MAX_REQUEST 8192
+// descriptors passed with a request: status pipe, stdin, stdout, stderr
+#define LAUNCH_MAX_FDS 4
+
+// which of the command's parts a request carries
+#define LAUNCH_HAS_IN 0x01
+#define LAUNCH_HAS_OUT 0x02
+#define LAUNCH_HAS_ERR 0x04
+#define LAUNCH_HAS_INPUT_FILE 0x08
+#define LAUNCH_HAS_OUTPUT_FILE 0x10
+#define LAUNCH_HAS_ERROR_FILE 0x20
+// the request is a launch_signal_t
+#define LAUNCH_SIGNAL 0x40
+
+// a launch request, followed by the NUL terminated working directory, the
+// arguments and the redirection files present. the status pipe comes first
+// among the descriptors, then the standard ones the flags name
+typedef struct {
+    int flags;
+    int argc;
+} launch_request_t;
+
+// a request to signal a command the helper started, it comes without descriptors
+typedef struct {
+    int flags;
+    int signal;
+    pid_t pid;
+} launch_signal_t;
+
+// what the helper writes to a command's status pipe once it has exited,
+// after the pid_t it writes once the command is started
+typedef struct {
+    int status;
+    struct rusage usage;
+} launch_exit_t;
+
+// a command the helper started and still has to report on
+typedef struct {
+    pid_t pid;
+    int status_fd;
+} launched_child_t;
+
+static int helper_socket = -1;
+static pid_t helper_pid = 0;
+
+// the helper
+
+// close every descriptor inherited from the server except keep_fd and stdio
+static void close_inherited_fds(int keep_fd) {
+#ifdef SYS_close_range
+    if ((keep_fd <= 3 || syscall(SYS_close_range, 3, keep_fd - 1, 0) == 0) &&
+        syscall(SYS_close_range, keep_fd + 1, ~0U, 0) == 0) {
+        return;
+    }
+#endif
+    long max_fd = sysconf(_SC_OPEN_MAX);
+    if (max_fd < 0 || max_fd > 65536) max_fd = 65536;
+    for (int fd = 3; fd < max_fd; fd++) {
+        if (fd != keep_fd) close(fd);
+    }
+}
+
+// write a whole record to a status pipe, the command's owner may be gone
+static void write_record(int fd, const void *record, size_t length) {
+    ssize_t written;
+    do {
+        written = write(fd, record, length);
+    } while (written < 0 && errno == EINTR);
+}
+
+// next NUL terminated string of a request, NULL if the request ends first
+static const char *next_string(const char **cursor, const char *end) {
+    const char *string = *cursor;
+    const char *nul = memchr(string, '\0', end - string);
+    if (!nul) return NULL;
+    *cursor = nul + 1;
+    return string;
+}
+
+// spawn the command a request describes, returns its pid or -1. the
+// descriptors are the ones that came with the request, status pipe first
+static pid_t handle_request(const char *request, size_t length, int *fds, int fd_count) {
+    const char *end = request + length;
+    launch_request_t header;
+    if (length < sizeof(header) || fd_count < 1) return -1;
+    memcpy(&header, request, sizeof(header));
+    const char *cursor = request + sizeof(header);
+    if (header.argc <= 0 || (size_t)header.argc > length) return -1;
+
+    int std_fds[3] = { -1, -1, -1 };
+    int next_fd = 1;
+    for (int i = 0; i < 3; i++) {
+        if (!(header.flags & (LAUNCH_HAS_IN << i))) continue;
+        if (next_fd >= fd_count) return -1;
+        std_fds[i] = fds[next_fd++];
+    }
+
+    char **args = calloc(header.argc + 1, sizeof(char *));
+    if (!args) return -1;
+    Command cmd = { args, NULL, NULL, NULL, 0 };
+    const char *cwd = next_string(&cursor, end);
+    int valid = cwd != NULL;
+    for (int i = 0; valid && i < header.argc; i++) {
+        valid = (args[i] = (char *)next_string(&cursor, end)) != NULL;
+    }
+    if (valid && (header.flags & LAUNCH_HAS_INPUT_FILE)) {
+        valid = (cmd.input_file = (char *)next_string(&cursor, end)) != NULL;
+    }
+    if (valid && (header.flags & LAUNCH_HAS_OUTPUT_FILE)) {
+        valid = (cmd.output_file = (char *)next_string(&cursor, end)) != NULL;
+    }
+    if (valid && (header.flags & LAUNCH_HAS_ERROR_FILE)) {
+        valid = (cmd.error_file = (char *)next_string(&cursor, end)) != NULL;
+    }
+
+    pid_t pid = -1;
+    if (valid) {
+        // commands start where the server is, cd only ever changes the server
+        // a path too long to remember is changed to every time
+        static char current_cwd[PATH_MAX];
+        size_t cwd_length = strlen(cwd);
+        if (strcmp(cwd, current_cwd) != 0 && chdir(cwd) == 0) {
+            if (cwd_length < sizeof(current_cwd)) memcpy(current_cwd, cwd, cwd_length + 1);
+            else current_cwd[0] = '\0';
+        }
+        pid = spawn_command(&cmd, std_fds[0], std_fds[1], std_fds[2]);
+    }
+    free(args);
+    return pid;
+}
+
+// report every exited command to its status pipe
+static void reap_children(launched_child_t *children, int *count) {
+    launch_exit_t record;
+    pid_t pid;
+    while ((pid = wait4(-1, &record.status, WNOHANG, &record.usage)) > 0) {
+        for (int i = 0; i < *count; i++) {
+            if (children[i].pid != pid) continue;
+            write_record(children[i].status_fd, &record, sizeof(record));
+            close(children[i].status_fd);
+            children[i] = children[--*count];
+            break;
+        }
+    }
+}
+
+// deliver a signal request, only to a command the helper has not reaped yet
+// so a pid that was reused since never gets it. exited commands waiting to
+// be reaped are zombies, which ignore it
+static void handle_signal(const launch_signal_t *request, const launched_child_t *children, int count) {
+    for (int i = 0; i < count; i++) {
+        if (children[i].pid == request->pid) {
+            kill(request->pid, request->signal);
+            return;
+        }
+    }
+}
+
+// the helper's loop, serves requests until the server closes its end
+static void run_helper(int sock) {
+    // a ^C on the terminal is for the server, which stops the helper by
+    // closing the socket. the server's shutdown handler is not ours
+    signal(SIGINT, SIG_IGN);
+    signal(SIGTERM, SIG_DFL);
+    sigset_t child_exits;
+    sigemptyset(&child_exits);
+    sigaddset(&child_exits, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &child_exits, NULL);
+    int signal_fd = signalfd(-1, &child_exits, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (signal_fd < 0) _exit(EXIT_FAILURE);
+
+    launched_child_t *children = NULL;
+    int child_count = 0, child_capacity = 0;
+    char request[LAUNCH_MAX_REQUEST];
+    union {
+        char buffer[CMSG_SPACE(LAUNCH_MAX_FDS * sizeof(int))];
+        struct cmsghdr align;
+    } control;
+
+    for (;;) {
+        struct pollfd pfds[2] = {
+            { .fd = sock, .events = POLLIN },
+            { .fd = signal_fd, .events = POLLIN },
+        };
+        if (poll(pfds, 2, -1) < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        if (pfds[1].revents) {
+            struct signalfd_siginfo info;
+            while (read(signal_fd, &info, sizeof(info)) > 0) {}
+            reap_children(children, &child_count);
+        }
+        if (!pfds[0].revents) continue;
+
+        struct iovec iov = { request, sizeof(request) };
+        struct msghdr msg = {0};
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control.buffer;
+        msg.msg_controllen = sizeof(control.buffer);
+        // received descriptors are close-on-exec, commands only get theirs
+        // through the dup2 file actions
+        ssize_t length = recvmsg(sock, &msg, MSG_CMSG_CLOEXEC);
+        if (length < 0 && errno == EINTR) continue;
+        if (length <= 0) break;
+
+        int fds[LAUNCH_MAX_FDS];
+        int fd_count = 0;
+        for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+            if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS) continue;
+            fd_count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+            memcpy(fds, CMSG_DATA(cmsg), fd_count * sizeof(int));
+        }
+        launch_signal_t signal_request;
+        if (fd_count == 0 && (size_t)length == sizeof(signal_request)) {
+            memcpy(&signal_request, request, sizeof(signal_request));
+            if (signal_request.flags & LAUNCH_SIGNAL) handle_signal(&signal_request, children, child_count);
+        }
+        if (fd_count == 0) continue;
+
+        pid_t pid = handle_request(request, length, fds, fd_count);
+        write_record(fds[0], &pid, sizeof(pid));
+        for (int i = 1; i < fd_count; i++) close(fds[i]);
+        if (pid <= 0) {
+            close(fds[0]);
+            continue;
+        }
+        if (child_count == child_capacity) {
+            int capacity = child_capacity ? child_capacity * 2 : 64;
+            launched_child_t *grown = realloc(children, capacity * sizeof(launched_child_t));
+            if (!grown) {
+                // the command runs unreported, its owner sees it end when the pipe closes
+                close(fds[0]);
+                continue;
+            }
+            children = grown;
+            child_capacity = capacity;
+        }
+        children[child_count].pid = pid;
+        children[child_count].status_fd = fds[0];
+        child_count++;
+    }
+    _exit(EXIT_SUCCESS);
+}
+
+// the server side
+
+int launcher_start(void) {
+    if (helper_socket >= 0) return 0;
+    int sv[2];
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, sv) < 0) {
+        perror("socketpair");
+        return -1;
+    }
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        close(sv[0]);
+        close(sv[1]);
+        return -1;
+    }
+    if (pid == 0) {
+        close_inherited_fds(sv[1]);
+        run_helper(sv[1]);
+    }
+    close(sv[1]);
+    helper_socket = sv[0];
+    helper_pid = pid;
+    return 0;
+}
+
+void launcher_stop(void) {
+    if (helper_socket < 0) return;
+    close(helper_socket);
+    helper_socket = -1;
+    waitpid(helper_pid, NULL, 0);
+    helper_pid = 0;
+}
+
+// a pidfd that polls readable once the process exits, -1 if the kernel has none
+static int open_pidfd(pid_t pid) {
+#ifdef SYS_pidfd_open
+    return (int)syscall(SYS_pidfd_open, pid, 0);
+#else
+    (void)pid;
+    return -1;
+#endif
+}
+
+// append a string and its NUL to a request, returns -1 if it does not fit
+static int append_string(char *request, size_t *length, const char *string) {
+    size_t size = strlen(string) + 1;
+    if (*length + size > LAUNCH_MAX_REQUEST) return -1;
+    memcpy(request + *length, string, size);
+    *length += size;
+    return 0;
+}
+
+// describe a command for the helper, returns the request length or 0 if it
+// does not fit
+static size_t pack_request(const Command *cmd, const int *std_fds, char *request) {
+    launch_request_t header = {0};
+    size_t length = sizeof(header);
+    char cwd[PATH_MAX];
+    if (!getcwd(cwd, sizeof(cwd)) || append_string(request, &length, cwd) != 0) return 0;
+    for (; cmd->args[header.argc]; header.argc++) {
+        if (append_string(request, &length, cmd->args[header.argc]) != 0) return 0;
+    }
+    for (int i = 0; i < 3; i++) {
+        if (std_fds[i] >= 0) header.flags |= LAUNCH_HAS_IN << i;
+    }
+    const char *files[3] = { cmd->input_file, cmd->output_file, cmd->error_file };
+    for (int i = 0; i < 3; i++) {
+        if (!files[i]) continue;
+        if (append_string(request, &length, files[i]) != 0) return 0;
+        header.flags |= LAUNCH_HAS_INPUT_FILE << i;
+    }
+    memcpy(request, &header, sizeof(header));
+    return length;
+}
+
+// send a request and its descriptors, returns -1 if the helper is gone
+static int send_request(const char *request, size_t length, const int *fds, int fd_count) {
+    union {
+        char buffer[CMSG_SPACE(LAUNCH_MAX_FDS * sizeof(int))];
+        struct cmsghdr align;
+    } control;
+    memset(&control, 0, sizeof(control));
+    struct iovec iov = { (void *)request, length };
+    struct msghdr msg = {0};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buffer;
+    msg.msg_controllen = CMSG_SPACE(fd_count * sizeof(int));
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(fd_count * sizeof(int));
+    memcpy(CMSG_DATA(cmsg), fds, fd_count * sizeof(int));
+
+    ssize_t sent;
+    do {
+        sent = sendmsg(helper_socket, &msg, MSG_NOSIGNAL);
+    } while (sent < 0 && errno == EINTR);
+    return sent == (ssize_t)length ? 0 : -1;
+}
+
+// read a whole record from a status pipe, returns 0 at end of file
+static ssize_t read_record(int fd, void *record, size_t length) {
+    size_t done = 0;
+    while (done < length) {
+        ssize_t got = read(fd, (char *)record + done, length - done);
+        if (got < 0 && errno == EINTR) continue;
+        if (got <= 0) return got;
+        done += got;
+    }
+    return done;
+}
+
+pid_t launcher_spawn(Command *cmd, int in_fd, int out_fd, int err_fd, int *exit_fd) {
+    *exit_fd = -1;
+    int report_fd = err_fd >= 0 ? err_fd : STDERR_FILENO;
+    int std_fds[3] = { in_fd, out_fd, err_fd };
+    char request[LAUNCH_MAX_REQUEST];
+    size_t length = 0;
+    int status_pipe[2] = { -1, -1 };
+
+    // builtins change the server, they never reach the helper
+    if (helper_socket >= 0 && handle_builtin_command(cmd, report_fd)) return 0;
+    if (helper_socket >= 0 && (length = pack_request(cmd, std_fds, request)) > 0 &&
+        pipe2(status_pipe, O_CLOEXEC) == 0) {
+        int fds[LAUNCH_MAX_FDS] = { status_pipe[1] };
+        int fd_count = 1;
+        for (int i = 0; i < 3; i++) {
+            if (std_fds[i] >= 0) fds[fd_count++] = std_fds[i];
+        }
+        int sent = send_request(request, length, fds, fd_count);
+        close(status_pipe[1]);
+        pid_t pid;
+        if (sent == 0 && read_record(status_pipe[0], &pid, sizeof(pid)) == sizeof(pid)) {
+            if (pid > 0) *exit_fd = status_pipe[0];
+            else close(status_pipe[0]);
+            return pid;
+        }
+        close(status_pipe[0]);
+        if (sent == 0) {
+            dprintf(report_fd, "launch helper stopped\n");
+            return -1;
+        }
+        // the request never reached the helper, start the command here
+    }
+
+    pid_t pid = spawn_command(cmd, in_fd, out_fd, err_fd);
+    if (pid > 0) *exit_fd = open_pidfd(pid);
+    return pid;
+}
+
+void launcher_signal(pid_t pid, int exit_fd, int sig) {
+    // a command spawned here is our child, its pid stays ours until we reap it
+    if (exit_fd < 0) {
+        kill(pid, sig);
+        return;
+    }
+#ifdef SYS_pidfd_send_signal
+    if (syscall(SYS_pidfd_send_signal, exit_fd, sig, NULL, 0) == 0 || errno != EBADF) return;
+#endif
+    // exit_fd is the helper's status pipe, only the helper knows whether the
+    // pid is still its command. requests are handled in order, so a SIGSTOP
+    // and the SIGCONT after it arrive that way
+    launch_signal_t request = { LAUNCH_SIGNAL, sig, pid };
+    ssize_t sent;
+    do {
+        sent = send(helper_socket, &request, sizeof(request), MSG_NOSIGNAL);
+    } while (sent < 0 && errno == EINTR);
+}
+
+int launcher_reap(pid_t pid, int *exit_fd, int options, int *status, struct rusage *usage) {
+    memset(usage, 0, sizeof(*usage));
+    // commands spawned here are our children, the helper's are not
+    pid_t result;
+    do {
+        result = wait4(pid, status, options, usage);
+    } while (result < 0 && errno == EINTR);
+    if (result == 0) return 0;
+    if (result < 0 && errno == ECHILD && *exit_fd >= 0) {
+        if (options & WNOHANG) {
+            struct pollfd pfd = { .fd = *exit_fd, .events = POLLIN };
+            if (poll(&pfd, 1, 0) <= 0) return 0;
+        }
+        launch_exit_t record;
+        if (read_record(*exit_fd, &record, sizeof(record)) == sizeof(record)) {
+            *status = record.status;
+            *usage = record.usage;
+        }
+    }
+    if (*exit_fd >= 0) {
+        close(*exit_fd);
+        *exit_fd = -1;
+    }
+    return 1;
+}
@@ -32,7 +32,7 @@ int main(int argc, char *argv[]) {
                     port = DEFAULT_PORT;
                 }
             }
-            start_server(port);
+            start_server(port, NULL);
             return 0;
         }
         // Client mode
@@ -66,6 +66,10 @@ int main(int argc, char *argv[]) {
     
     // Local shell mode (original code)
     char input[MAX_INPUT_SIZE];
+    // every command is parsed into the same arena, a line always fits
+    char arena_buffer[PARSE_ARENA_STACK_SIZE];
+    parse_arena_t arena;
+    parse_arena_init(&arena, arena_buffer, sizeof(arena_buffer));
 
     while (1) {
         printf("$ ");
@@ -90,20 +94,20 @@ int main(int argc, char *argv[]) {
                 fprintf(stderr, "Error: Empty command between pipes.\n");
                 continue;
             }
-            execute_pipeline(input);
+            execute_pipeline(input, -1, -1, -1);
             continue;
         }
 
         // parse a single command
-        Command *cmd = parse_command(input);
+        Command *cmd = parse_command(&arena, input);
         if (!cmd) {
             fprintf(stderr, "Parsing error.\n");
             continue;
         }
 
         // execute the parsed command
-        execute_command(cmd);
-        free_command(cmd);
+        execute_command(cmd, -1, -1, -1);
+        free_command(&arena, cmd);
     }
 
     return 0;
@@ -0,0 +1,89 @@
+#include "mlfq.h"
+#include "scheduler.h"
+
+void mlfq_init(mlfq_t *mlfq, int level_count, const int *quanta, int boost_interval_ms, long long now_ms) {
+    if (level_count < 1) level_count = 1;
+    if (level_count > MLFQ_MAX_LEVELS) level_count = MLFQ_MAX_LEVELS;
+    
+    for (int i = 0; i < MLFQ_MAX_LEVELS; i++) {
+        mlfq->levels[i].head = NULL;
+        mlfq->levels[i].tail = NULL;
+        mlfq->quantum_ms[i] = i < level_count && quanta[i] > 0 ? quanta[i] : 1;
+    }
+    mlfq->level_count = level_count;
+    mlfq->boost_interval_ms = boost_interval_ms;
+    mlfq->boost_epoch = boost_interval_ms > 0 ? now_ms / boost_interval_ms : 0;
+    mlfq->size = 0;
+}
+
+void mlfq_push(mlfq_t *mlfq, task_t *task) {
+    // a task that was running during a boost is boosted when it comes back.
+    // one from a queue that is ahead of this one already had that boost
+    if (task->boost_epoch < mlfq->boost_epoch) {
+        task->level = 0;
+        task->boost_epoch = mlfq->boost_epoch;
+    }
+    
+    mlfq_level_t *level = &mlfq->levels[task->level];
+    task->run_next = NULL;
+    task->run_prev = level->tail;
+    if (level->tail) level->tail->run_next = task;
+    else level->head = task;
+    level->tail = task;
+    mlfq->size++;
+}
+
+task_t *mlfq_peek(const mlfq_t *mlfq) {
+    for (int i = 0; i < mlfq->level_count; i++) {
+        if (mlfq->levels[i].head) return mlfq->levels[i].head;
+    }
+    return NULL;
+}
+
+void mlfq_remove(mlfq_t *mlfq, task_t *task) {
+    mlfq_level_t *level = &mlfq->levels[task->level];
+    if (task->run_prev) task->run_prev->run_next = task->run_next;
+    else level->head = task->run_next;
+    if (task->run_next) task->run_next->run_prev = task->run_prev;
+    else level->tail = task->run_prev;
+    task->run_prev = NULL;
+    task->run_next = NULL;
+    mlfq->size--;
+}
+
+int mlfq_quantum(const mlfq_t *mlfq, const task_t *task) {
+    return mlfq->quantum_ms[task->level];
+}
+
+void mlfq_charge(mlfq_t *mlfq, task_t *task, int used_ms) {
+    // giving the cpu up early keeps the level, burning the slice costs one
+    if (used_ms >= mlfq_quantum(mlfq, task) && task->level < mlfq->level_count - 1) {
+        task->level++;
+    }
+}
+
+void mlfq_boost_if_due(mlfq_t *mlfq, long long now_ms) {
+    if (mlfq->boost_interval_ms <= 0 || now_ms / mlfq->boost_interval_ms <= mlfq->boost_epoch) {
+        return;
+    }
+    mlfq->boost_epoch = now_ms / mlfq->boost_interval_ms;
+    
+    // append every lower level to the top one, keeping their order
+    mlfq_level_t *top = &mlfq->levels[0];
+    for (int i = 1; i < mlfq->level_count; i++) {
+        mlfq_level_t *level = &mlfq->levels[i];
+        if (!level->head) continue;
+        for (task_t *task = level->head; task; task = task->run_next) {
+            task->level = 0;
+        }
+        level->head->run_prev = top->tail;
+        if (top->tail) top->tail->run_next = level->head;
+        else top->head = level->head;
+        top->tail = level->tail;
+        level->head = NULL;
+        level->tail = NULL;
+    }
+    for (task_t *task = top->head; task; task = task->run_next) {
+        task->boost_epoch = mlfq->boost_epoch;
+    }
+}
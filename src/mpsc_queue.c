@@ -0,0 +1,45 @@
+#include <stddef.h>
+#include "mpsc_queue.h"
+
+void mpsc_init(mpsc_queue_t *queue) {
+    queue->stub.next = NULL;
+    queue->head = &queue->stub;
+    queue->tail = &queue->stub;
+}
+
+void mpsc_push(mpsc_queue_t *queue, mpsc_node_t *node) {
+    __atomic_store_n(&node->next, NULL, __ATOMIC_RELAXED);
+    // the exchange orders producers, linking the previous node publishes ours
+    mpsc_node_t *prev = __atomic_exchange_n(&queue->head, node, __ATOMIC_ACQ_REL);
+    __atomic_store_n(&prev->next, node, __ATOMIC_RELEASE);
+}
+
+mpsc_node_t *mpsc_pop(mpsc_queue_t *queue) {
+    mpsc_node_t *tail = queue->tail;
+    mpsc_node_t *next = __atomic_load_n(&tail->next, __ATOMIC_ACQUIRE);
+
+    // step over the stub
+    if (tail == &queue->stub) {
+        if (!next) return NULL;
+        queue->tail = next;
+        tail = next;
+        next = __atomic_load_n(&tail->next, __ATOMIC_ACQUIRE);
+    }
+    if (next) {
+        queue->tail = next;
+        return tail;
+    }
+
+    // tail is the last node unless a producer is still linking a newer one
+    mpsc_node_t *head = __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE);
+    if (tail != head) return NULL;
+
+    // put the stub back behind tail so tail can be handed out
+    mpsc_push(queue, &queue->stub);
+    next = __atomic_load_n(&tail->next, __ATOMIC_ACQUIRE);
+    if (next) {
+        queue->tail = next;
+        return tail;
+    }
+    return NULL;
+}
@@ -3,196 +3,224 @@
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <stdint.h>
 #include "parser.h"
+#include "scan.h"
 
-#define MAX_TOKENS 64
+// everything carved from an arena is aligned for pointers
+#define ARENA_ALIGN sizeof(char *)
 
-// parse a command while handling quotes and redirection with care
-Command* parse_command(const char *input) {
-    Command *cmd = malloc(sizeof(Command));
-    if (!cmd) {
-        perror("malloc");
-        return NULL;
+static size_t align_up(size_t n) {
+    return (n + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+}
+
+size_t parse_arena_size(size_t input_length) {
+    // the strings never take more than the input plus a terminator, and
+    // every argument but the last is followed by at least one more byte
+    // so there are at most half as many as input bytes plus one. the rest
+    // is alignment of the buffer, the Command and the argv
+    return 3 * ARENA_ALIGN + align_up(sizeof(Command)) + align_up(input_length + 1) +
+           (input_length / 2 + 2) * sizeof(char *);
+}
+
+void parse_arena_init(parse_arena_t *arena, void *buffer, size_t size) {
+    size_t pad = (ARENA_ALIGN - (uintptr_t)buffer % ARENA_ALIGN) % ARENA_ALIGN;
+    arena->base = (char *)buffer + pad;
+    arena->size = size > pad ? (size - pad) & ~(ARENA_ALIGN - 1) : 0;
+    arena->used = 0;
+    arena->heap = NULL;
+}
+
+int parse_arena_reserve(parse_arena_t *arena, void *buffer, size_t size, size_t needed) {
+    if (buffer && needed <= size) {
+        parse_arena_init(arena, buffer, size);
+        return 0;
     }
-    cmd->args = malloc(MAX_TOKENS * sizeof(char*));
-    if (!cmd->args) {
+    void *block = malloc(needed);
+    if (!block) {
         perror("malloc");
-        free(cmd);
-        return NULL;
+        return -1;
     }
+    parse_arena_init(arena, block, needed);
+    arena->heap = block;
+    return 0;
+}
+
+void parse_arena_release(parse_arena_t *arena) {
+    free(arena->heap);
+    arena->heap = NULL;
+}
+
+// copy the bytes from src up to end to out, returns the end of the copy or
+// NULL if it would reach limit
+static char *copy_run(char *out, const char *limit, const char *src, const char *end) {
+    size_t length = end - src;
+    if ((size_t)(limit - out) < length) return NULL;
+    memcpy(out, src, length);
+    return out + length;
+}
+
+// copy a redirection filename to out, quoted or up to the next space
+// returns the end of the copy or NULL if it reaches limit
+static char *copy_filename(const char **curr_ptr, char *out, const char *limit) {
+    const char *curr = *curr_ptr;
+    // move past any extra spaces to reach the filename
+    while (isspace((unsigned char)*curr)) curr++;
+
+    // if the filename is quoted, extract everything within the quotes
+    if (*curr == '"' || *curr == '\'') {
+        char quote_char = *curr++;
+        const char *run = scan_until(curr, SCAN_QUOTE);
+        // the other kind of quote is part of the name
+        while (*run && *run != quote_char) run = scan_until(run + 1, SCAN_QUOTE);
+        out = copy_run(out, limit, curr, run);
+        curr = run;
+        if (*curr == quote_char) curr++; // skip the closing quote
+    } else {
+        // if not quoted, grab characters until the next space
+        const char *run = scan_until(curr, SCAN_SPACE);
+        out = copy_run(out, limit, curr, run);
+        curr = run;
+    }
+    if (!out || out == limit) return NULL;
+    *out = '\0';
+    *curr_ptr = curr;
+    return out;
+}
 
+// parse a command while handling quotes and redirection with care
+// tokens are written straight into the arena from its front while the argv
+// pointers pile up at its back, once the command is done the argv is moved
+// down behind the strings. a redirection operator is overwritten by its filename
+// the classifier finds the next space or quote, the bytes before it are
+// copied as one run
+Command* parse_command(parse_arena_t *arena, const char *input) {
+    size_t mark = arena->used;
+    char *end = arena->base + arena->size;
+    if (arena->size - mark < align_up(sizeof(Command))) {
+        fprintf(stderr, "Error: Command too long.\n");
+        return NULL;
+    }
+    Command *cmd = (Command *)(arena->base + mark);
+    cmd->args = NULL;
     cmd->input_file = NULL;
     cmd->output_file = NULL;
     cmd->error_file = NULL;
     cmd->pipe_count = 0;
 
-    // create a duplicate of the input so we can modify it safely
-    char *input_copy = strdup(input);
-    if (!input_copy) {
-        perror("strdup");
-        free(cmd->args);
-        free(cmd);
-        return NULL;
-    }
-
-    int arg_index = 0;
-    char *curr = input_copy;
+    char *out = (char *)cmd + align_up(sizeof(Command));
+    char **argv_top = (char **)end;    // argv in reverse, growing down
+    const char *curr = input;
     int in_quotes = 0;
     char quote_char = '\0';
-    char token[1024] = {0};
-    int token_index = 0;
-
-    // loop through each character in the input until we reach the end or fill our tokens
-    while (*curr != '\0' && arg_index < MAX_TOKENS - 1) {
-        // check if we hit a quote and it isn't escaped
-        if ((*curr == '"' || *curr == '\'') && (curr == input_copy || *(curr-1) != '\\')) {
-            if (!in_quotes) {
-                in_quotes = 1;
-                quote_char = *curr;
-                curr++;
-                continue;
-            } else if (*curr == quote_char) {
-                in_quotes = 0;
-                curr++;
-                continue;
+    char *token = out;
+
+    // loop through the input a run at a time until we reach the end
+    while (*curr != '\0') {
+        // inside quotes only a quote can end the run, outside a space too
+        const char *run = scan_until(curr, in_quotes ? SCAN_QUOTE : SCAN_SPACE | SCAN_QUOTE);
+        out = copy_run(out, (char *)argv_top, curr, run);
+        if (!out) goto out_of_room;
+        curr = run;
+        if (*curr == '\0') break;
+
+        if (*curr == '"' || *curr == '\'') {
+            // check if we hit a quote and it isn't escaped
+            if (curr == input || *(curr-1) != '\\') {
+                if (!in_quotes) {
+                    in_quotes = 1;
+                    quote_char = *curr;
+                    curr++;
+                    continue;
+                } else if (*curr == quote_char) {
+                    in_quotes = 0;
+                    curr++;
+                    continue;
+                }
             }
-        }
-
-        // if we're inside quotes or encountering non-space characters, build the current token
-        if (in_quotes || (!isspace(*curr) && *curr != '\0')) {
-            token[token_index++] = *curr++;
+            // an escaped quote or the other kind inside quotes is part of the token
+            if (out == (char *)argv_top) goto out_of_room;
+            *out++ = *curr++;
             continue;
         }
 
-        // reached a delimiter (space or end), so finish processing the token we've built
-        if (token_index > 0) {
-            token[token_index] = '\0';
-            token_index = 0;
+        // reached a delimiter, so finish processing the token we've built
+        if (out > token) {
+            if (out == (char *)argv_top) goto out_of_room;
+            *out = '\0';
 
             // check if token is a redirection operator and handle accordingly
-            if (strcmp(token, "<") == 0) {
-                // move past any extra spaces to reach the filename
-                while (isspace(*curr)) curr++;
-
-                // capture the filename for input redirection, accounting for quotes if needed
-                char filename[1024] = {0};
-                int f_index = 0;
-                
-                // if the filename is quoted, extract everything within the quotes
-                if (*curr == '"' || *curr == '\'') {
-                    quote_char = *curr++;
-                    while (*curr && *curr != quote_char) {
-                        filename[f_index++] = *curr++;
-                    }
-                    if (*curr == quote_char) curr++; // skip the closing quote
-                } else {
-                    // if not quoted, grab characters until the next space
-                    while (*curr && !isspace(*curr)) {
-                        filename[f_index++] = *curr++;
-                    }
-                }
-                
-                filename[f_index] = '\0';
-                cmd->input_file = strdup(filename);
-            } else if (strcmp(token, ">") == 0) {
-                // skip spaces before the output filename starts
-                while (isspace(*curr)) curr++;
-
-                // capture the filename for output redirection, supporting quoted filenames
-                char filename[1024] = {0};
-                int f_index = 0;
-                
-                // if filename is enclosed in quotes, process accordingly
-                if (*curr == '"' || *curr == '\'') {
-                    quote_char = *curr++;
-                    while (*curr && *curr != quote_char) {
-                        filename[f_index++] = *curr++;
-                    }
-                    if (*curr == quote_char) curr++; // skip the closing quote
-                } else {
-                    while (*curr && !isspace(*curr)) {
-                        filename[f_index++] = *curr++;
-                    }
-                }
-                
-                filename[f_index] = '\0';
-                cmd->output_file = strdup(filename);
-            } else if (strcmp(token, "2>") == 0) {
-                // skip any extra spaces to locate the error redirection filename
-                while (isspace(*curr)) curr++;
-
-                // capture the filename for error redirection, handling quotes if present
-                char filename[1024] = {0};
-                int f_index = 0;
-                
-                // if the filename is quoted, extract the content within the quotes
-                if (*curr == '"' || *curr == '\'') {
-                    quote_char = *curr++;
-                    while (*curr && *curr != quote_char) {
-                        filename[f_index++] = *curr++;
-                    }
-                    if (*curr == quote_char) curr++; // skip over the closing quote
-                } else {
-                    while (*curr && !isspace(*curr)) {
-                        filename[f_index++] = *curr++;
-                    }
-                }
-                
-                filename[f_index] = '\0';
-                cmd->error_file = strdup(filename);
+            char **redirect = NULL;
+            if (strcmp(token, "<") == 0) redirect = &cmd->input_file;
+            else if (strcmp(token, ">") == 0) redirect = &cmd->output_file;
+            else if (strcmp(token, "2>") == 0) redirect = &cmd->error_file;
+
+            if (redirect) {
+                out = copy_filename(&curr, token, (char *)argv_top);
+                if (!out) goto out_of_room;
+                *redirect = token;
+                out++;
             } else if (strcmp(token, "|") == 0) {
                 // found a pipe symbol, so just increase our pipe count for later processing
                 cmd->pipe_count++;
+                out = token;
             } else {
                 // it's a normal argument, so add it to our list of command arguments
-                cmd->args[arg_index++] = strdup(token);
+                if ((char *)(argv_top - 1) < out + 1) goto out_of_room;
+                *--argv_top = token;
+                out++;
             }
+            token = out;
         }
 
         // skip any spaces between tokens to get ready for the next token
-        while (isspace(*curr)) curr++;
+        while (isspace((unsigned char)*curr)) curr++;
     }
 
     // if we exit the loop while still inside a quote, that's an error because quotes didn't match
     if (in_quotes) {
         fprintf(stderr, "Error: Unmatched quotes.\n");
-        free_command(cmd);
-        free(input_copy);
+        arena->used = mark;
         return NULL;
     }
 
     // if there's any token data left at the end, add it to our command arguments
-    if (token_index > 0) {
-        token[token_index] = '\0';
-        cmd->args[arg_index++] = strdup(token);
+    if (out > token) {
+        if (out == (char *)argv_top || (char *)(argv_top - 1) < out + 1) goto out_of_room;
+        *out++ = '\0';
+        *--argv_top = token;
     }
 
-    // mark the end of our arguments list with a null pointer for execvp compatibility
-    cmd->args[arg_index] = NULL;
-
     // if no arguments were added, then no command was provided, which is an error
-    if (arg_index == 0) {
+    size_t arg_count = (char **)end - argv_top;
+    if (arg_count == 0) {
         fprintf(stderr, "Error: No command specified.\n");
-        free_command(cmd);
-        free(input_copy);
+        arena->used = mark;
         return NULL;
     }
 
-    // free our temporary duplicate of the input, as it's no longer needed
-    free(input_copy);
+    // put the arguments back in order and move them behind the strings,
+    // ending with a null pointer for execvp compatibility
+    char **args = (char **)(arena->base + align_up(out - arena->base));
+    if ((char *)(args + arg_count + 1) > end) goto out_of_room;
+    for (size_t i = 0, j = arg_count - 1; i < j; i++, j--) {
+        char *swap = argv_top[i];
+        argv_top[i] = argv_top[j];
+        argv_top[j] = swap;
+    }
+    memmove(args, argv_top, arg_count * sizeof(char *));
+    args[arg_count] = NULL;
+    cmd->args = args;
+    arena->used = (char *)(args + arg_count + 1) - arena->base;
     return cmd;
+
+out_of_room:
+    fprintf(stderr, "Error: Command too long.\n");
+    arena->used = mark;
+    return NULL;
 }
 
-void free_command(Command *cmd) {
+void free_command(parse_arena_t *arena, Command *cmd) {
     if (!cmd) return;
-    if (cmd->args) {
-        for (int i = 0; cmd->args[i] != NULL; i++) {
-            free(cmd->args[i]);
-        }
-        free(cmd->args);
-    }
-    if (cmd->input_file) free(cmd->input_file);
-    if (cmd->output_file) free(cmd->output_file);
-    if (cmd->error_file) free(cmd->error_file);
-    free(cmd);
+    arena->used = (char *)cmd - arena->base;
 }
@@ -0,0 +1,198 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/inotify.h>
+#include "path_cache.h"
+
+#define PATH_CACHE_BUCKETS 256
+#define PATH_CACHE_MAX_ENTRIES 1024
+// what execvp searches when $PATH is unset
+#define DEFAULT_SEARCH_PATH "/bin:/usr/bin"
+// changes to a $PATH directory that can change what a name resolves to
+#define WATCH_MASK (IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_ATTRIB | \
+                    IN_DELETE_SELF | IN_MOVE_SELF)
+
+typedef struct path_entry {
+    char *name;                 // command name as typed
+    char *path;                 // executable it resolved to
+    struct path_entry *next;    // next entry in the same bucket
+} path_entry;
+
+static path_entry *buckets[PATH_CACHE_BUCKETS];
+static int entry_count = 0;
+static char *search_path = NULL;    // copy of $PATH taken on first use
+static int watch_fd = -1;           // inotify descriptor watching the $PATH directories
+static int cache_state = 0;         // 0 before first use, 1 caching, -1 disabled
+static pthread_mutex_t path_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// djb2 string hash
+static unsigned long hash_name(const char *name) {
+    unsigned long hash = 5381;
+    for (const unsigned char *c = (const unsigned char *)name; *c; c++) {
+        hash = hash * 33 + *c;
+    }
+    return hash % PATH_CACHE_BUCKETS;
+}
+
+// forget every resolved name, caller holds the cache lock
+static void flush_entries(void) {
+    for (int i = 0; i < PATH_CACHE_BUCKETS; i++) {
+        path_entry *entry = buckets[i];
+        while (entry) {
+            path_entry *next = entry->next;
+            free(entry->name);
+            free(entry->path);
+            free(entry);
+            entry = next;
+        }
+        buckets[i] = NULL;
+    }
+    entry_count = 0;
+}
+
+// watch every $PATH directory, returns -1 if a directory cannot be watched
+// reliably. directories that do not exist are skipped. caller holds the cache lock
+static int watch_search_path(void) {
+    char *dirs = strdup(search_path);
+    if (!dirs) return -1;
+    int result = 0;
+    // an empty entry means the working directory, which cd can change under us
+    if (dirs[0] == '\0' || dirs[0] == ':' || dirs[strlen(dirs) - 1] == ':' || strstr(dirs, "::")) {
+        result = -1;
+    }
+    char *saveptr = NULL;
+    for (char *dir = strtok_r(dirs, ":", &saveptr); dir && result == 0; dir = strtok_r(NULL, ":", &saveptr)) {
+        if (dir[0] != '/') {
+            result = -1;
+        } else if (inotify_add_watch(watch_fd, dir, WATCH_MASK) < 0 && errno != ENOENT && errno != ENOTDIR) {
+            result = -1;
+        }
+    }
+    free(dirs);
+    return result;
+}
+
+// set up on first use, caller holds the cache lock
+static void init_cache(void) {
+    const char *env_path = getenv("PATH");
+    search_path = strdup(env_path ? env_path : DEFAULT_SEARCH_PATH);
+    watch_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (!search_path || watch_fd < 0 || watch_search_path() != 0) {
+        // without a way to notice changes, every spawn searches $PATH itself
+        if (watch_fd >= 0) close(watch_fd);
+        watch_fd = -1;
+        cache_state = -1;
+        return;
+    }
+    cache_state = 1;
+}
+
+// flush the cache if a $PATH directory changed since the last lookup
+// a watch that went away (directory removed or renamed) or an overflowed
+// event queue also rewatches the directories, caller holds the cache lock
+static void check_for_changes(void) {
+    char events[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    int changed = 0, rewatch = 0;
+    ssize_t length;
+    while ((length = read(watch_fd, events, sizeof(events))) > 0) {
+        changed = 1;
+        for (char *ptr = events; ptr < events + length; ) {
+            const struct inotify_event *event = (const struct inotify_event *)ptr;
+            if (event->mask & (IN_IGNORED | IN_Q_OVERFLOW)) rewatch = 1;
+            ptr += sizeof(struct inotify_event) + event->len;
+        }
+    }
+    if (changed) flush_entries();
+    if (rewatch) watch_search_path();
+}
+
+static path_entry *find_entry(const char *name) {
+    for (path_entry *entry = buckets[hash_name(name)]; entry; entry = entry->next) {
+        if (strcmp(entry->name, name) == 0) return entry;
+    }
+    return NULL;
+}
+
+// search $PATH the way execvp does and cache the result, caller holds the cache lock
+static path_entry *add_entry(const char *name) {
+    char *dirs = strdup(search_path);
+    if (!dirs) return NULL;
+    char candidate[PATH_MAX];
+    char *found = NULL;
+    char *saveptr = NULL;
+    for (char *dir = strtok_r(dirs, ":", &saveptr); dir && !found; dir = strtok_r(NULL, ":", &saveptr)) {
+        struct stat st;
+        if (snprintf(candidate, sizeof(candidate), "%s/%s", dir, name) >= (int)sizeof(candidate)) continue;
+        if (stat(candidate, &st) == 0 && S_ISREG(st.st_mode) && access(candidate, X_OK) == 0) {
+            found = strdup(candidate);
+        }
+    }
+    free(dirs);
+    if (!found) return NULL;
+
+    // the table starts over instead of growing without bound
+    if (entry_count >= PATH_CACHE_MAX_ENTRIES) flush_entries();
+    path_entry *entry = malloc(sizeof(path_entry));
+    if (!entry || !(entry->name = strdup(name))) {
+        free(entry);
+        free(found);
+        return NULL;
+    }
+    entry->path = found;
+    unsigned long bucket = hash_name(name);
+    entry->next = buckets[bucket];
+    buckets[bucket] = entry;
+    entry_count++;
+    return entry;
+}
+
+int path_cache_resolve(const char *name, char *path, size_t size) {
+    if (strchr(name, '/')) return -1;
+
+    int result = -1;
+    pthread_mutex_lock(&path_cache_lock);
+    if (cache_state == 0) init_cache();
+    if (cache_state > 0) {
+        check_for_changes();
+        path_entry *entry = find_entry(name);
+        if (!entry) entry = add_entry(name);
+        if (entry && strlen(entry->path) < size) {
+            strcpy(path, entry->path);
+            result = 0;
+        }
+    }
+    pthread_mutex_unlock(&path_cache_lock);
+    return result;
+}
+
+void path_cache_forget(const char *name) {
+    pthread_mutex_lock(&path_cache_lock);
+    path_entry **link = &buckets[hash_name(name)];
+    while (*link && strcmp((*link)->name, name) != 0) link = &(*link)->next;
+    if (*link) {
+        path_entry *entry = *link;
+        *link = entry->next;
+        free(entry->name);
+        free(entry->path);
+        free(entry);
+        entry_count--;
+    }
+    pthread_mutex_unlock(&path_cache_lock);
+}
+
+void path_cache_cleanup(void) {
+    pthread_mutex_lock(&path_cache_lock);
+    flush_entries();
+    if (watch_fd >= 0) close(watch_fd);
+    watch_fd = -1;
+    free(search_path);
+    search_path = NULL;
+    cache_state = 0;
+    pthread_mutex_unlock(&path_cache_lock);
+}
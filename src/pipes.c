@@ -3,19 +3,30 @@
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
-#include <sys/wait.h>
+#include <fcntl.h>
+#include <pthread.h>
 #include <errno.h>
+#include <stdint.h>
 #include "pipes.h"
 #include "parser.h"
-#include "redirection.h"
+#include "executor.h"
+#include "launcher.h"
+#include "scan.h"
 
-// max commands in a pipeline
-#define MAX_COMMANDS 10
+#define PLAN_CACHE_BUCKETS 256
+#define PLAN_CACHE_CAPACITY 128
+
+// compiled plans by command string, the most recently used at the head
+static pipeline_plan_t *plan_buckets[PLAN_CACHE_BUCKETS];
+static pipeline_plan_t *lru_head = NULL;
+static pipeline_plan_t *lru_tail = NULL;
+static int cached_plans = 0;
+static pthread_mutex_t plan_cache_lock = PTHREAD_MUTEX_INITIALIZER;
 
 // helper: Trim leading/trailing whitespace
 char *trim_whitespace(char *str) {
     if (!str || *str == '\0') return str;  // check for empty string
-    
+
     while(*str == ' ') str++;
     char *end = str + strlen(str) - 1;
     while(end > str && (*end == ' ' || *end == '\n')) {
@@ -25,100 +36,264 @@ char *trim_whitespace(char *str) {
     return str;
 }
 
-void execute_pipeline(const char *input) {
-    // duplicate input to avoid modifying the original string.
+// hash of a command string, mixed in 8 byte words so long generated
+// commands do not cost more to look up than to compile
+static unsigned long hash_input(const char *input, size_t length) {
+    uint64_t hash = 0xcbf29ce484222325ULL ^ length;
+    size_t i = 0;
+    for (; i + 8 <= length; i += 8) {
+        uint64_t word;
+        memcpy(&word, input + i, sizeof(word));
+        hash = (hash ^ word) * 0x100000001b3ULL;
+        hash ^= hash >> 32;
+    }
+    uint64_t tail = 0;
+    memcpy(&tail, input + i, length - i);
+    hash = (hash ^ tail) * 0x100000001b3ULL;
+    return (unsigned long)(hash ^ (hash >> 29));
+}
+
+static void free_plan(pipeline_plan_t *plan) {
+    parse_arena_release(&plan->arena);
+    free(plan->input);
+    free(plan);
+}
+
+// split the input on the pipe symbols outside quotes, the pieces point into
+// input which is modified. returns the number of stages, -1 if there are too many
+static int split_stages(char *input, char **stages) {
+    int count = 0;
+    char quote_char = '\0';
+    stages[count++] = input;
+    // only quotes and pipe symbols matter, the classifier skips to the next one
+    for (char *c = (char *)scan_until(input, SCAN_QUOTE | SCAN_PIPE); *c;
+         c = (char *)scan_until(c + 1, SCAN_QUOTE | SCAN_PIPE)) {
+        if ((*c == '"' || *c == '\'') && (c == input || *(c-1) != '\\')) {
+            if (!quote_char) quote_char = *c;
+            else if (*c == quote_char) quote_char = '\0';
+        } else if (*c == '|' && !quote_char) {
+            if (count == MAX_COMMANDS) return -1;
+            *c = '\0';
+            stages[count++] = c + 1;
+        }
+    }
+    return count;
+}
+
+pipeline_plan_t *pipeline_plan_compile(const char *input, int err_fd) {
+    int report_fd = err_fd >= 0 ? err_fd : STDERR_FILENO;
+    pipeline_plan_t *plan = calloc(1, sizeof(pipeline_plan_t));
     char *input_copy = strdup(input);
+    if (!plan || !input_copy) {
+        perror("malloc");
+        free(plan);
+        free(input_copy);
+        return NULL;
+    }
+    plan->refs = 1;
+
     char *commands[MAX_COMMANDS];
-    int num_commands = 0;
+    int num_commands = split_stages(input_copy, commands);
+    if (num_commands < 0) {
+        dprintf(report_fd, "Error: more than %d commands in a pipeline.\n", MAX_COMMANDS);
+        free(input_copy);
+        free_plan(plan);
+        return NULL;
+    }
+    // all stages go into one arena sized for the worst case
+    size_t arena_size = 0;
+    for (int i = 0; i < num_commands; i++) {
+        commands[i] = trim_whitespace(commands[i]);
+        arena_size += parse_arena_size(strlen(commands[i]));
+    }
+    if (parse_arena_reserve(&plan->arena, NULL, 0, arena_size) != 0) {
+        free(input_copy);
+        free_plan(plan);
+        return NULL;
+    }
+    // every stage parses before anything is started
+    for (int i = 0; i < num_commands; i++) {
+        Command *cmd = parse_command(&plan->arena, commands[i]);
+        if (!cmd) {
+            dprintf(report_fd, "Parsing error in pipeline command.\n");
+            free(input_copy);
+            free_plan(plan);
+            return NULL;
+        }
+        plan->stages[plan->stage_count++] = cmd;
+    }
+    free(input_copy);
 
-    // split input on the pipe symbol.
-    char *token = strtok(input_copy, "|");
-    while (token != NULL && num_commands < MAX_COMMANDS) {
-        commands[num_commands++] = trim_whitespace(token);
-        token = strtok(NULL, "|");
+    plan->input = strdup(input);
+    if (!plan->input) {
+        perror("strdup");
+        free_plan(plan);
+        return NULL;
     }
+    return plan;
+}
 
-    int pipefds[2 * (num_commands - 1)];
-    for (int i = 0; i < num_commands - 1; i++) {
-        if (pipe(pipefds + i * 2) < 0) {
-            perror("pipe");
-            free(input_copy);
-            return;
+// unlink a plan from the recency list, caller holds the cache lock
+static void lru_unlink(pipeline_plan_t *plan) {
+    if (plan->lru_prev) plan->lru_prev->lru_next = plan->lru_next;
+    else lru_head = plan->lru_next;
+    if (plan->lru_next) plan->lru_next->lru_prev = plan->lru_prev;
+    else lru_tail = plan->lru_prev;
+    plan->lru_prev = plan->lru_next = NULL;
+}
+
+// make a plan the most recently used, caller holds the cache lock
+static void lru_push_front(pipeline_plan_t *plan) {
+    plan->lru_prev = NULL;
+    plan->lru_next = lru_head;
+    if (lru_head) lru_head->lru_prev = plan;
+    lru_head = plan;
+    if (!lru_tail) lru_tail = plan;
+}
+
+// find a cached plan and take a reference to it, caller holds the cache lock
+// the stored length and hash rule out most other plans before the compare
+static pipeline_plan_t *lookup_plan(const char *input, size_t length, unsigned long hash) {
+    for (pipeline_plan_t *plan = plan_buckets[hash % PLAN_CACHE_BUCKETS]; plan; plan = plan->bucket_next) {
+        if (plan->input_hash == hash && plan->input_length == length &&
+            memcmp(plan->input, input, length) == 0) {
+            lru_unlink(plan);
+            lru_push_front(plan);
+            plan->refs++;
+            return plan;
         }
     }
+    return NULL;
+}
 
-    for (int i = 0; i < num_commands; i++) {
-        pid_t pid = fork();
-        if (pid < 0) {
-            perror("fork");
-            free(input_copy);
-            return;
+// drop the least recently used plan from the cache, caller holds the cache lock
+// returns it if nobody else holds it any more, so it can be freed unlocked
+static pipeline_plan_t *evict_plan(void) {
+    pipeline_plan_t *plan = lru_tail;
+    pipeline_plan_t **link = &plan_buckets[plan->input_hash % PLAN_CACHE_BUCKETS];
+    while (*link != plan) link = &(*link)->bucket_next;
+    *link = plan->bucket_next;
+    lru_unlink(plan);
+    cached_plans--;
+    return --plan->refs == 0 ? plan : NULL;
+}
+
+pipeline_plan_t *pipeline_plan_get(const char *input, int err_fd) {
+    size_t length = strlen(input);
+    unsigned long hash = hash_input(input, length);
+    pthread_mutex_lock(&plan_cache_lock);
+    pipeline_plan_t *plan = lookup_plan(input, length, hash);
+    pthread_mutex_unlock(&plan_cache_lock);
+    if (plan) return plan;
+
+    // compile outside the lock, commands that fail to parse are not cached
+    pipeline_plan_t *compiled = pipeline_plan_compile(input, err_fd);
+    if (!compiled) return NULL;
+
+    pipeline_plan_t *evicted = NULL;
+    pthread_mutex_lock(&plan_cache_lock);
+    // another worker may have compiled the same command meanwhile
+    plan = lookup_plan(input, length, hash);
+    if (!plan) {
+        if (cached_plans >= PLAN_CACHE_CAPACITY) evicted = evict_plan();
+        plan = compiled;
+        compiled = NULL;
+        plan->input_length = length;
+        plan->input_hash = hash;
+        unsigned long bucket = hash % PLAN_CACHE_BUCKETS;
+        plan->bucket_next = plan_buckets[bucket];
+        plan_buckets[bucket] = plan;
+        lru_push_front(plan);
+        cached_plans++;
+        plan->refs++;   // the cache's own reference
+    }
+    pthread_mutex_unlock(&plan_cache_lock);
+
+    if (compiled) free_plan(compiled);
+    if (evicted) free_plan(evicted);
+    return plan;
+}
+
+void pipeline_plan_release(pipeline_plan_t *plan) {
+    if (!plan) return;
+    pthread_mutex_lock(&plan_cache_lock);
+    int unused = --plan->refs == 0;
+    pthread_mutex_unlock(&plan_cache_lock);
+    if (unused) free_plan(plan);
+}
+
+void pipeline_cache_cleanup(void) {
+    pipeline_plan_t *unused = NULL;
+    pthread_mutex_lock(&plan_cache_lock);
+    while (lru_tail) {
+        pipeline_plan_t *plan = evict_plan();
+        if (plan) {
+            plan->lru_next = unused;
+            unused = plan;
         }
-        if (pid == 0) {
-            // if not the first command, redirect stdin to the previous pipe's read end.
-            if (i > 0) {
-                if (dup2(pipefds[(i - 1) * 2], 0) < 0) {
-                    perror("dup2 stdin");
-                    exit(EXIT_FAILURE);
-                }
-            }
-            // if not the last command, redirect stdout to the current pipe's write end.
-            if (i < num_commands - 1) {
-                if (dup2(pipefds[i * 2 + 1], 1) < 0) {
-                    perror("dup2 stdout");
-                    exit(EXIT_FAILURE);
-                }
-            }
-            // close all pipe file descriptors in the child
-            for (int j = 0; j < 2 * (num_commands - 1); j++) {
-                close(pipefds[j]);
-            }
+    }
+    pthread_mutex_unlock(&plan_cache_lock);
+    while (unused) {
+        pipeline_plan_t *next = unused->lru_next;
+        free_plan(unused);
+        unused = next;
+    }
+}
 
-            // parse the individual command
-            Command *cmd = parse_command(commands[i]);
-            if (!cmd) {
-                fprintf(stderr, "Parsing error in pipeline command.\n");
-                exit(EXIT_FAILURE);
+// start every stage of a compiled pipeline through the launcher
+// the pipes between stages are close-on-exec, each stage only receives its
+// own ends through the dup2 file actions spawn_command sets up, so pipelines
+// can be started from several threads at once. like a shell, a stage that
+// fails to start does not stop the others, the next stage just reads an
+// empty input
+int spawn_plan(const pipeline_plan_t *plan, int in_fd, int out_fd, int err_fd, pid_t *pids, int *exit_fds) {
+    int started = 0;
+    int stage_in = in_fd;       // read end the next stage takes as stdin
+    for (int i = 0; i < plan->stage_count; i++) {
+        int pipefd[2] = { -1, -1 };
+        int stage_out = out_fd;
+        if (i < plan->stage_count - 1) {
+            if (pipe(pipefd) < 0) {
+                perror("pipe");
+                break;
             }
+            fcntl(pipefd[0], F_SETFD, FD_CLOEXEC);
+            fcntl(pipefd[1], F_SETFD, FD_CLOEXEC);
+            stage_out = pipefd[1];
+        }
 
-            // handle redirects
-            if (cmd->input_file) {
-                if (redirect_input(cmd->input_file) != 0){
-                    free_command(cmd);
-                    exit(EXIT_FAILURE);
-                }
-            }
-            if (cmd->output_file) {
-                if (redirect_output(cmd->output_file) != 0){
-                    free_command(cmd);
-                    exit(EXIT_FAILURE);
-                }
-            }
-            if (cmd->error_file) {
-                if (redirect_error(cmd->error_file) != 0){
-                    free_command(cmd);
-                    exit(EXIT_FAILURE);
-                }
-            }
+        int exit_fd;
+        pid_t pid = launcher_spawn(plan->stages[i], stage_in, stage_out, err_fd, &exit_fd);
 
-            if (execvp(cmd->args[0], cmd->args) < 0) {
-                if (errno == ENOENT) {
-                    fprintf(stderr, "Command not found: %s\n", cmd->args[0]);
-                } else {
-                    perror("execvp");
-                }
-                free_command(cmd);
-                exit(EXIT_FAILURE);
-            }
+        // the parent keeps no pipe ends the stages use
+        if (stage_in != in_fd) close(stage_in);
+        if (pipefd[1] >= 0) close(pipefd[1]);
+        stage_in = pipefd[0];
+        if (pid > 0) {
+            exit_fds[started] = exit_fd;
+            pids[started++] = pid;
         }
     }
-    // parent: Close all pipe file descriptors.
-    for (int i = 0; i < 2 * (num_commands - 1); i++) {
-        close(pipefds[i]);
-    }
+    if (stage_in != in_fd && stage_in >= 0) close(stage_in);
+    return started;
+}
+
+int spawn_pipeline(const char *input, int in_fd, int out_fd, int err_fd, pid_t *pids, int *exit_fds) {
+    pipeline_plan_t *plan = pipeline_plan_get(input, err_fd);
+    if (!plan) return -1;
+    int started = spawn_plan(plan, in_fd, out_fd, err_fd, pids, exit_fds);
+    pipeline_plan_release(plan);
+    return started;
+}
+
+void execute_pipeline(const char *input, int in_fd, int out_fd, int err_fd) {
+    pid_t pids[MAX_COMMANDS];
+    int exit_fds[MAX_COMMANDS];
+    int started = spawn_pipeline(input, in_fd, out_fd, err_fd, pids, exit_fds);
     // wait for all child processes.
-    for (int i = 0; i < num_commands; i++) {
-        wait(NULL);
+    for (int i = 0; i < started; i++) {
+        int status;
+        struct rusage usage;
+        launcher_reap(pids[i], &exit_fds[i], 0, &status, &usage);
     }
-    free(input_copy);
 }
@@ -1,57 +1,34 @@
+#define _POSIX_C_SOURCE 200809L
 #include <stdio.h>
+#include <string.h>
+#include <errno.h>
 #include <fcntl.h>
 #include <unistd.h>
 #include "redirection.h"
 
-// redirect input from a file
-// this function opens the given file in read-only mode and then uses dup2 to replace
-// the standard input with the file descriptor from the opened file.
-// if anything goes wrong, it prints an error and returns -1.
-int redirect_input(const char *filename) {
-    int fd = open(filename, O_RDONLY); // try to open the file for reading
+// open a redirection file for a spawned command
+// the descriptor is close-on-exec, so it only reaches the child through a
+// dup2 file action and never leaks into commands other workers spawn.
+// failures are reported to err_fd like perror would
+static int open_redirect(const char *filename, int flags, const char *what, int err_fd) {
+    int fd = open(filename, flags | O_CLOEXEC, 0644);
     if (fd < 0) {
-        perror("open input file"); // report error if file opening fails
-        return -1;
+        dprintf(err_fd >= 0 ? err_fd : STDERR_FILENO, "%s: %s\n", what, strerror(errno));
     }
-    if (dup2(fd, STDIN_FILENO) < 0) {
-        perror("dup2 input"); // report error if duplicating file descriptor fails
-        return -1;
-    }
-    close(fd); // close the original file descriptor as it's no longer needed
-    return 0; // indicate success
+    return fd;
 }
 
-// redirect output to a file
-// this function opens or creates the specified file in write-only mode (truncating it if it exists),
-// then uses dup2 to redirect standard output to that file.
-// errors are reported and -1 is returned if any operation fails.
-int redirect_output(const char *filename) {
-    int fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0644); // open or create the file for writing
-    if (fd < 0) {
-        perror("open output file"); // report error if file opening fails
-        return -1;
-    }
-    if (dup2(fd, STDOUT_FILENO) < 0) {
-        perror("dup2 output"); // report error if duplicating file descriptor fails
-        return -1;
-    }
-    close(fd); // close the original file descriptor
-    return 0; // indicate success
+// open the file a command reads its input from
+int open_input_redirect(const char *filename, int err_fd) {
+    return open_redirect(filename, O_RDONLY, "open input file", err_fd);
 }
 
-// redirect error output to a file
-// this function works similarly to redirect_output but targets standard error.
-// it opens or creates the specified file, then redirects standard error to that file.
-int redirect_error(const char *filename) {
-    int fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0644); // open or create the error file
-    if (fd < 0) {
-        perror("open error file"); // report error if file opening fails
-        return -1;
-    }
-    if (dup2(fd, STDERR_FILENO) < 0) {
-        perror("dup2 error"); // report error if duplicating file descriptor fails
-        return -1;
-    }
-    close(fd); // close the original file descriptor
-    return 0; // indicate success
+// open or truncate the file a command writes its output to
+int open_output_redirect(const char *filename, int err_fd) {
+    return open_redirect(filename, O_WRONLY | O_CREAT | O_TRUNC, "open output file", err_fd);
+}
+
+// open or truncate the file a command writes its errors to
+int open_error_redirect(const char *filename, int err_fd) {
+    return open_redirect(filename, O_WRONLY | O_CREAT | O_TRUNC, "open error file", err_fd);
 }
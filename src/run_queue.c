@@ -0,0 +1,126 @@
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "run_queue.h"
+#include "scheduler.h"
+#include "client_stats.h"
+
+// default mlfq: short slices first, the sjrf quanta further down
+#define MLFQ_DEFAULT_LEVELS 3
+#define MLFQ_DEFAULT_BOOST 20000
+static const int mlfq_default_quanta[MLFQ_DEFAULT_LEVELS] = {1000, FIRST_ROUND_QUANTUM, OTHER_ROUNDS_QUANTUM};
+
+// fill a config with the default settings
+void scheduler_config_defaults(scheduler_config_t *config) {
+    config->num_workers = 0;
+    config->max_tasks = 0;
+    config->admission = ADMISSION_REJECT;
+    config->algorithm = SCHED_ALG_SJRF;
+    config->mlfq_levels = MLFQ_DEFAULT_LEVELS;
+    for (int i = 0; i < MLFQ_MAX_LEVELS; i++) {
+        config->mlfq_quantum_ms[i] = mlfq_default_quanta[i < MLFQ_DEFAULT_LEVELS ? i : MLFQ_DEFAULT_LEVELS - 1];
+    }
+    config->mlfq_boost_ms = MLFQ_DEFAULT_BOOST;
+    config->cpu_penalty_ms = CLIENT_CPU_PENALTY_DEFAULT_MS;
+}
+
+int scheduler_parse_quanta(char *list, int *quanta) {
+    int levels = 0;
+    for (char *item = strtok(list, ","); item; item = strtok(NULL, ",")) {
+        if (levels == MLFQ_MAX_LEVELS) return -1;
+        quanta[levels] = atoi(item);
+        if (quanta[levels] <= 0) return -1;
+        levels++;
+    }
+    return levels > 0 ? levels : -1;
+}
+
+int run_queue_init(run_queue_t *rq, const scheduler_config_t *config, long long now_ms) {
+    rq->policy = sched_policy_get(config->algorithm);
+    rq->last_executed = NULL;
+    rq->waiting = 0;
+    rq->submitted = 0;
+    mpsc_init(&rq->intake);
+
+    if (rq->policy->init(rq, config, now_ms) != 0) return -1;
+    if (pthread_mutex_init(&rq->lock, NULL) != 0) {
+        rq->policy->destroy(rq);
+        return -1;
+    }
+    return 0;
+}
+
+void run_queue_destroy(run_queue_t *rq) {
+    pthread_mutex_destroy(&rq->lock);
+    rq->policy->destroy(rq);
+}
+
+int run_queue_push(run_queue_t *rq, task_t *task) {
+    if (rq->policy->enqueue(rq, task) != 0) return -1;
+    task->state = TASK_STATE_WAITING;
+    task->rq = rq;
+    rq->waiting++;
+    return 0;
+}
+
+void run_queue_submit(run_queue_t *rq, task_t *task) {
+    task->state = TASK_STATE_SUBMITTED;
+    task->rq = rq;
+    __atomic_add_fetch(&rq->submitted, 1, __ATOMIC_SEQ_CST);
+    mpsc_push(&rq->intake, &task->intake_node);
+}
+
+int run_queue_drain(run_queue_t *rq) {
+    int drained = 0;
+    mpsc_node_t *node;
+    while ((node = mpsc_pop(&rq->intake))) {
+        task_t *task = (task_t *)((char *)node - offsetof(task_t, intake_node));
+        if (run_queue_push(rq, task) != 0) {
+            // no room in the policy, leave the task for the next drain
+            perror("malloc failed");
+            mpsc_push(&rq->intake, node);
+            break;
+        }
+        drained++;
+    }
+    if (drained) __atomic_sub_fetch(&rq->submitted, drained, __ATOMIC_SEQ_CST);
+    return drained;
+}
+
+int run_queue_length(run_queue_t *rq) {
+    return __atomic_load_n(&rq->waiting, __ATOMIC_RELAXED) + 
+           __atomic_load_n(&rq->submitted, __ATOMIC_RELAXED);
+}
+
+void run_queue_remove(run_queue_t *rq, task_t *task) {
+    if (task->state != TASK_STATE_WAITING || task->rq != rq) return;
+    rq->policy->on_remove(rq, task);
+    rq->waiting--;
+}
+
+task_t *run_queue_pick(run_queue_t *rq, long long now_ms) {
+    run_queue_drain(rq);
+    task_t *selected_task = rq->policy->pick_next(rq, now_ms);
+    if (selected_task) {
+        run_queue_remove(rq, selected_task);
+        selected_task->state = TASK_STATE_RUNNING;
+    }
+    return selected_task;
+}
+
+int run_queue_runs_before(const run_queue_t *rq, const task_t *a, const task_t *b) {
+    return rq->policy->runs_before(a, b);
+}
+
+int run_queue_quantum(const run_queue_t *rq, const task_t *task) {
+    return rq->policy->quantum(rq, task);
+}
+
+void run_queue_quantum_end(run_queue_t *rq, task_t *task, int used_ms) {
+    if (rq->policy->on_quantum_end) rq->policy->on_quantum_end(rq, task, used_ms);
+}
+
+void run_queue_complete(run_queue_t *rq, task_t *task) {
+    if (rq->policy->on_complete) rq->policy->on_complete(rq, task);
+}
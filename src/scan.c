@@ -0,0 +1,141 @@
+#include <stdint.h>
+#include "scan.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SCAN_X86 1
+#include <immintrin.h>
+#endif
+
+// the terminating NUL, which every scan stops at
+#define SCAN_END 0x80
+
+static const unsigned char byte_class[256] = {
+    ['\0'] = SCAN_END,
+    ['\t'] = SCAN_SPACE, ['\n'] = SCAN_SPACE, ['\v'] = SCAN_SPACE,
+    ['\f'] = SCAN_SPACE, ['\r'] = SCAN_SPACE, [' '] = SCAN_SPACE,
+    ['"'] = SCAN_QUOTE, ['\''] = SCAN_QUOTE,
+    ['\\'] = SCAN_ESCAPE,
+    ['<'] = SCAN_REDIRECT, ['>'] = SCAN_REDIRECT,
+    ['|'] = SCAN_PIPE,
+};
+
+static const char *scan_scalar(const char *s, unsigned classes) {
+    unsigned stop = classes | SCAN_END;
+    while (!(byte_class[(unsigned char)*s] & stop)) s++;
+    return s;
+}
+
+#ifdef SCAN_X86
+// the block loads are aligned so they never cross into the next page, but
+// they do read past the NUL, which is why address checks are off for them
+
+// bit per byte of v that is in one of the classes or NUL
+static inline unsigned classify_sse2(__m128i v, unsigned classes) {
+    __m128i hit = _mm_cmpeq_epi8(v, _mm_setzero_si128());
+    if (classes & SCAN_SPACE) {
+        // \t..\r are consecutive, v - '\t' <= 4 unsigned picks them out
+        __m128i control = _mm_sub_epi8(v, _mm_set1_epi8('\t'));
+        hit = _mm_or_si128(hit, _mm_cmpeq_epi8(_mm_min_epu8(control, _mm_set1_epi8(4)), control));
+        hit = _mm_or_si128(hit, _mm_cmpeq_epi8(v, _mm_set1_epi8(' ')));
+    }
+    if (classes & SCAN_QUOTE) {
+        hit = _mm_or_si128(hit, _mm_cmpeq_epi8(v, _mm_set1_epi8('"')));
+        hit = _mm_or_si128(hit, _mm_cmpeq_epi8(v, _mm_set1_epi8('\'')));
+    }
+    if (classes & SCAN_ESCAPE) hit = _mm_or_si128(hit, _mm_cmpeq_epi8(v, _mm_set1_epi8('\\')));
+    if (classes & SCAN_REDIRECT) {
+        hit = _mm_or_si128(hit, _mm_cmpeq_epi8(v, _mm_set1_epi8('<')));
+        hit = _mm_or_si128(hit, _mm_cmpeq_epi8(v, _mm_set1_epi8('>')));
+    }
+    if (classes & SCAN_PIPE) hit = _mm_or_si128(hit, _mm_cmpeq_epi8(v, _mm_set1_epi8('|')));
+    return (unsigned)_mm_movemask_epi8(hit);
+}
+
+__attribute__((no_sanitize_address))
+static const char *scan_sse2(const char *s, unsigned classes) {
+    unsigned offset = (uintptr_t)s & 15;
+    const __m128i *block = (const __m128i *)(s - offset);
+    // drop the bytes in front of s from the first block
+    unsigned mask = classify_sse2(_mm_load_si128(block), classes) >> offset;
+    if (mask) return s + __builtin_ctz(mask);
+    for (;;) {
+        block++;
+        mask = classify_sse2(_mm_load_si128(block), classes);
+        if (mask) return (const char *)block + __builtin_ctz(mask);
+    }
+}
+
+__attribute__((target("avx2")))
+static inline unsigned classify_avx2(__m256i v, unsigned classes) {
+    __m256i hit = _mm256_cmpeq_epi8(v, _mm256_setzero_si256());
+    if (classes & SCAN_SPACE) {
+        __m256i control = _mm256_sub_epi8(v, _mm256_set1_epi8('\t'));
+        hit = _mm256_or_si256(hit, _mm256_cmpeq_epi8(_mm256_min_epu8(control, _mm256_set1_epi8(4)), control));
+        hit = _mm256_or_si256(hit, _mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')));
+    }
+    if (classes & SCAN_QUOTE) {
+        hit = _mm256_or_si256(hit, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('"')));
+        hit = _mm256_or_si256(hit, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\'')));
+    }
+    if (classes & SCAN_ESCAPE) hit = _mm256_or_si256(hit, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\\')));
+    if (classes & SCAN_REDIRECT) {
+        hit = _mm256_or_si256(hit, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('<')));
+        hit = _mm256_or_si256(hit, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('>')));
+    }
+    if (classes & SCAN_PIPE) hit = _mm256_or_si256(hit, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('|')));
+    return (unsigned)_mm256_movemask_epi8(hit);
+}
+
+__attribute__((target("avx2"), no_sanitize_address))
+static const char *scan_avx2(const char *s, unsigned classes) {
+    unsigned offset = (uintptr_t)s & 31;
+    const __m256i *block = (const __m256i *)(s - offset);
+    unsigned mask = classify_avx2(_mm256_load_si256(block), classes) >> offset;
+    if (mask) return s + __builtin_ctz(mask);
+    for (;;) {
+        block++;
+        mask = classify_avx2(_mm256_load_si256(block), classes);
+        if (mask) return (const char *)block + __builtin_ctz(mask);
+    }
+}
+#endif
+
+typedef const char *(*scan_fn)(const char *s, unsigned classes);
+
+static scan_fn scan_impl = NULL;    // picked on first use
+
+int scan_set_level(int level) {
+    scan_fn impl = scan_scalar;
+    int used = SCAN_LEVEL_SCALAR;
+#ifdef SCAN_X86
+    __builtin_cpu_init();
+    if (level >= SCAN_LEVEL_AVX2 && __builtin_cpu_supports("avx2")) {
+        impl = scan_avx2;
+        used = SCAN_LEVEL_AVX2;
+    } else if (level >= SCAN_LEVEL_SSE2 && __builtin_cpu_supports("sse2")) {
+        impl = scan_sse2;
+        used = SCAN_LEVEL_SSE2;
+    }
+#else
+    (void)level;
+#endif
+    __atomic_store_n(&scan_impl, impl, __ATOMIC_RELAXED);
+    return used;
+}
+
+const char *scan_level_name(int level) {
+    switch (level) {
+    case SCAN_LEVEL_AVX2: return "avx2";
+    case SCAN_LEVEL_SSE2: return "sse2";
+    default: return "scalar";
+    }
+}
+
+const char *scan_until(const char *s, unsigned classes) {
+    scan_fn impl = __atomic_load_n(&scan_impl, __ATOMIC_RELAXED);
+    if (!impl) {
+        scan_set_level(SCAN_LEVEL_BEST);
+        impl = __atomic_load_n(&scan_impl, __ATOMIC_RELAXED);
+    }
+    return impl(s, classes);
+}
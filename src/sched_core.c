@@ -0,0 +1,121 @@
+#include <pthread.h>
+#include "sched_core.h"
+#include "scheduler.h"
+#include "run_queue.h"
+#include "client_stats.h"
+
+void sched_prepare_task(task_t *task, int client_id, int type, int time_ms, int priority,
+                        int deadline_ms, long long now_ms) {
+    task->client_id = client_id;
+    task->type = type;
+    task->total_time = time_ms;
+    task->remaining_time = time_ms;
+    task->round = 1;
+    task->preempted = 0;
+    task->priority = priority;
+    // clients that used a lot of cpu lately queue behind the others
+    task->penalty = client_stats_penalty(client_id, now_ms);
+    task->deadline_ms = deadline_ms > 0 ? now_ms + deadline_ms : 0;
+    task->submitted_ms = now_ms;
+    task->enqueued_ms = now_ms;
+    task->wait_ms = 0;
+    task->heap_index = -1;
+    task->rq = NULL;
+}
+
+int sched_place(const sched_host_t *host, const task_t *task, int *preempt) {
+    int home = task->client_id % host->worker_count;
+    *preempt = 0;
+    if (host->idle(host->ctx, home)) return home;
+    for (int i = 0; i < host->worker_count; i++) {
+        if (i != home && host->idle(host->ctx, i)) return i;
+    }
+
+    // shell commands beat any program, programs beat longer running programs
+    int victim = -1;
+    task_t victim_running, running;
+    for (int i = 0; i < host->worker_count; i++) {
+        // look at the home worker first so it wins ties
+        int worker = (task->client_id + i) % host->worker_count;
+        run_queue_t *rq = host->queue(host->ctx, worker);
+        int candidate = host->running(host->ctx, worker, &running) && running.type == TASK_PROGRAM &&
+                        run_queue_runs_before(rq, task, &running) &&
+                        (victim < 0 || run_queue_runs_before(rq, &victim_running, &running));
+        if (candidate) {
+            victim = worker;
+            victim_running = running;
+        }
+    }
+    if (victim < 0 || !host->preempt(host->ctx, victim)) return home;
+    *preempt = 1;
+    return victim;
+}
+
+// take the best task from the busiest peer, which becomes the thief's task
+static task_t *steal_task(const sched_host_t *host, int thief) {
+    run_queue_t *victim = NULL;
+    int most_waiting = 0;
+    for (int i = 0; i < host->worker_count; i++) {
+        run_queue_t *rq = host->queue(host->ctx, i);
+        int waiting = run_queue_length(rq);
+        if (i != thief && waiting > most_waiting) {
+            victim = rq;
+            most_waiting = waiting;
+        }
+    }
+    if (!victim) return NULL;
+
+    pthread_mutex_lock(&victim->lock);
+    task_t *task = run_queue_pick(victim, host->now_ms(host->ctx));
+    // after its quantum the task is requeued on the thief
+    if (task) {
+        run_queue_complete(victim, task);
+        task->rq = host->queue(host->ctx, thief);
+    }
+    pthread_mutex_unlock(&victim->lock);
+    return task;
+}
+
+// whether a task can no longer finish before its deadline
+static int misses_deadline(const task_t *task, long long now_ms) {
+    return task->deadline_ms > 0 && now_ms + task->remaining_time > task->deadline_ms;
+}
+
+task_t *sched_next_task(const sched_host_t *host, int worker) {
+    run_queue_t *rq = host->queue(host->ctx, worker);
+    for (;;) {
+        pthread_mutex_lock(&rq->lock);
+        task_t *task = run_queue_pick(rq, host->now_ms(host->ctx));
+        pthread_mutex_unlock(&rq->lock);
+        if (!task) task = steal_task(host, worker);
+        if (!task) return NULL;
+
+        long long now = host->now_ms(host->ctx);
+        task->wait_ms += now - task->enqueued_ms;
+        if (!misses_deadline(task, now)) return task;
+        host->drop(host->ctx, task);
+    }
+}
+
+int sched_slice_ms(const task_t *task) {
+    int quantum = run_queue_quantum(task->rq, task);
+    return task->remaining_time < quantum ? task->remaining_time : quantum;
+}
+
+int sched_quantum_end(task_t *task, int executed_ms, long long now_ms) {
+    run_queue_t *rq = task->rq;
+    task->remaining_time -= executed_ms;
+    run_queue_quantum_end(rq, task, executed_ms);
+    // a cancelled task stays with its worker, which completes it
+    if (task->remaining_time <= 0 || task->cancelled) return 0;
+    task->round++;
+    task->preempted = 1;
+    task->enqueued_ms = now_ms;
+    return run_queue_push(rq, task) == 0 ? 1 : -1;
+}
+
+long long sched_record_completion(const task_t *task, long long now_ms) {
+    long long wall_ms = now_ms - task->submitted_ms;
+    client_stats_record(task->client_id, &task->usage, task->wait_ms, wall_ms, now_ms);
+    return wall_ms;
+}
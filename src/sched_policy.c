@@ -0,0 +1,310 @@
+#include <string.h>
+#include <limits.h>
+#include "sched_policy.h"
+#include "run_queue.h"
+#include "scheduler.h"
+
+// orderings of waiting tasks
+// every ordering puts the tasks of clients with a smaller cpu penalty first,
+// the priority policy by adding the penalty to the priority and the others
+// by comparing it before their own key
+
+// submission order
+static int submission_less(const task_t *a, const task_t *b) {
+    if (a->penalty != b->penalty) return a->penalty < b->penalty;
+    return a->id < b->id;
+}
+
+// fewest rounds first, so a preempted program goes behind the ones that waited
+static int round_less(const task_t *a, const task_t *b) {
+    if (a->penalty != b->penalty) return a->penalty < b->penalty;
+    if (a->round != b->round) return a->round < b->round;
+    return a->id < b->id;
+}
+
+// shortest remaining (or estimated) run time first, ties in submission order
+static int remaining_less(const task_t *a, const task_t *b) {
+    if (a->penalty != b->penalty) return a->penalty < b->penalty;
+    if (a->remaining_time != b->remaining_time) {
+        return a->remaining_time < b->remaining_time;
+    }
+    return a->id < b->id;
+}
+
+// the priority a task is ordered by, lowered by its client's cpu use
+static int effective_priority(const task_t *task) {
+    return task->priority + task->penalty;
+}
+
+// lowest priority value first, then round robin
+static int priority_less(const task_t *a, const task_t *b) {
+    if (effective_priority(a) != effective_priority(b)) return effective_priority(a) < effective_priority(b);
+    if (a->round != b->round) return a->round < b->round;
+    return a->id < b->id;
+}
+
+// tasks without a deadline sort after every task with one
+static long long deadline_key(const task_t *task) {
+    return task->deadline_ms > 0 ? task->deadline_ms : LLONG_MAX;
+}
+
+// earliest deadline first, then submission order
+static int deadline_less(const task_t *a, const task_t *b) {
+    if (a->penalty != b->penalty) return a->penalty < b->penalty;
+    if (deadline_key(a) != deadline_key(b)) return deadline_key(a) < deadline_key(b);
+    return a->id < b->id;
+}
+
+// policies keeping shell commands and programs in two heaps
+
+static task_heap_t *heap_for(run_queue_t *rq, task_t *task) {
+    return task->type == TASK_SHELL_COMMAND ? &rq->shell_tasks : &rq->program_tasks;
+}
+
+static int heaps_init(run_queue_t *rq, task_heap_less_fn shell_order, task_heap_less_fn program_order) {
+    if (task_heap_init(&rq->shell_tasks, shell_order) != 0) return -1;
+    if (task_heap_init(&rq->program_tasks, program_order) != 0) {
+        task_heap_destroy(&rq->shell_tasks);
+        return -1;
+    }
+    return 0;
+}
+
+static void heaps_destroy(run_queue_t *rq) {
+    task_heap_destroy(&rq->shell_tasks);
+    task_heap_destroy(&rq->program_tasks);
+}
+
+static int heaps_enqueue(run_queue_t *rq, task_t *task) {
+    return task_heap_push(heap_for(rq, task), task);
+}
+
+static void heaps_remove(run_queue_t *rq, task_t *task) {
+    task_heap_remove(heap_for(rq, task), task);
+}
+
+// shell commands before programs of clients with the same cpu penalty
+static task_t *shell_first_pick(run_queue_t *rq, long long now_ms) {
+    (void)now_ms;
+    task_t *shell_task = task_heap_peek(&rq->shell_tasks);
+    task_t *program_task = task_heap_peek(&rq->program_tasks);
+    if (!shell_task || (program_task && program_task->penalty < shell_task->penalty)) return program_task;
+    return shell_task;
+}
+
+// the round robin quanta
+static int round_quantum(const run_queue_t *rq, const task_t *task) {
+    (void)rq;
+    return (task->round == 1) ? FIRST_ROUND_QUANTUM : OTHER_ROUNDS_QUANTUM;
+}
+
+// fifo: every task runs to completion in submission order
+
+static int fifo_init(run_queue_t *rq, const scheduler_config_t *config, long long now_ms) {
+    (void)config;
+    (void)now_ms;
+    return heaps_init(rq, submission_less, submission_less);
+}
+
+static task_t *fifo_pick_next(run_queue_t *rq, long long now_ms) {
+    (void)now_ms;
+    task_t *shell_task = task_heap_peek(&rq->shell_tasks);
+    task_t *program_task = task_heap_peek(&rq->program_tasks);
+    if (!shell_task) return program_task;
+    if (!program_task) return shell_task;
+    return submission_less(shell_task, program_task) ? shell_task : program_task;
+}
+
+static int fifo_quantum(const run_queue_t *rq, const task_t *task) {
+    (void)rq;
+    return task->remaining_time;
+}
+
+static int fifo_runs_before(const task_t *a, const task_t *b) {
+    (void)a;
+    (void)b;
+    return 0;
+}
+
+// rr: shell commands in submission order, programs take turns
+
+static int rr_init(run_queue_t *rq, const scheduler_config_t *config, long long now_ms) {
+    (void)config;
+    (void)now_ms;
+    return heaps_init(rq, submission_less, round_less);
+}
+
+static int rr_runs_before(const task_t *a, const task_t *b) {
+    if (a->penalty != b->penalty) return a->penalty < b->penalty;
+    return a->type == TASK_SHELL_COMMAND && b->type == TASK_PROGRAM;
+}
+
+// sjrf: shortest remaining time first over programs and estimated shell commands
+
+static int sjrf_runs_before(const task_t *a, const task_t *b) {
+    if (a->penalty != b->penalty) return a->penalty < b->penalty;
+    return a->remaining_time < b->remaining_time;
+}
+
+static int sjrf_init(run_queue_t *rq, const scheduler_config_t *config, long long now_ms) {
+    (void)config;
+    (void)now_ms;
+    return heaps_init(rq, remaining_less, remaining_less);
+}
+
+static task_t *sjrf_pick_next(run_queue_t *rq, long long now_ms) {
+    (void)now_ms;
+    task_t *shell_task = task_heap_peek(&rq->shell_tasks);
+    task_t *program_task = task_heap_peek(&rq->program_tasks);
+    // prevent consecutive execution unless it's the only task
+    if (program_task == rq->last_executed && rq->program_tasks.size > 1) {
+        program_task = task_heap_runner_up(&rq->program_tasks);
+    }
+    // estimated shell commands win ties
+    task_t *selected_task = shell_task;
+    if (!selected_task || (program_task && sjrf_runs_before(program_task, shell_task))) {
+        selected_task = program_task;
+    }
+    if (selected_task) rq->last_executed = selected_task;
+    return selected_task;
+}
+
+static void sjrf_on_complete(run_queue_t *rq, task_t *task) {
+    if (rq->last_executed == task) rq->last_executed = NULL;
+}
+
+// priority: lowest priority value first, round robin within a priority
+
+static int priority_init(run_queue_t *rq, const scheduler_config_t *config, long long now_ms) {
+    (void)config;
+    (void)now_ms;
+    return heaps_init(rq, priority_less, priority_less);
+}
+
+static task_t *priority_pick_next(run_queue_t *rq, long long now_ms) {
+    (void)now_ms;
+    task_t *shell_task = task_heap_peek(&rq->shell_tasks);
+    task_t *program_task = task_heap_peek(&rq->program_tasks);
+    // shell commands win ties
+    if (!shell_task || (program_task && effective_priority(program_task) < effective_priority(shell_task))) {
+        return program_task;
+    }
+    return shell_task;
+}
+
+static int priority_runs_before(const task_t *a, const task_t *b) {
+    if (effective_priority(a) != effective_priority(b)) return effective_priority(a) < effective_priority(b);
+    return a->type == TASK_SHELL_COMMAND && b->type == TASK_PROGRAM;
+}
+
+// edf: earliest deadline first, tasks without one in submission order after them
+
+static int edf_init(run_queue_t *rq, const scheduler_config_t *config, long long now_ms) {
+    (void)config;
+    (void)now_ms;
+    return heaps_init(rq, deadline_less, deadline_less);
+}
+
+static int edf_runs_before(const task_t *a, const task_t *b) {
+    if (a->penalty != b->penalty) return a->penalty < b->penalty;
+    if (deadline_key(a) != deadline_key(b)) return deadline_key(a) < deadline_key(b);
+    return a->type == TASK_SHELL_COMMAND && b->type == TASK_PROGRAM;
+}
+
+static task_t *edf_pick_next(run_queue_t *rq, long long now_ms) {
+    (void)now_ms;
+    task_t *shell_task = task_heap_peek(&rq->shell_tasks);
+    task_t *program_task = task_heap_peek(&rq->program_tasks);
+    // shell commands win ties
+    if (!shell_task || (program_task && edf_runs_before(program_task, shell_task))) {
+        return program_task;
+    }
+    return shell_task;
+}
+
+// mlfq: shell commands in submission order, programs in feedback levels
+
+static int mlfq_policy_init(run_queue_t *rq, const scheduler_config_t *config, long long now_ms) {
+    if (heaps_init(rq, submission_less, submission_less) != 0) return -1;
+    mlfq_init(&rq->program_levels, config->mlfq_levels, config->mlfq_quantum_ms,
+              config->mlfq_boost_ms, now_ms);
+    return 0;
+}
+
+// a program that has not run yet starts one level down per penalty level
+static int mlfq_enqueue(run_queue_t *rq, task_t *task) {
+    if (task->type == TASK_SHELL_COMMAND) return heaps_enqueue(rq, task);
+    mlfq_t *mlfq = &rq->program_levels;
+    if (task->round == 1) {
+        task->level = task->penalty < mlfq->level_count ? task->penalty : mlfq->level_count - 1;
+        task->boost_epoch = mlfq->boost_epoch;
+    }
+    mlfq_push(mlfq, task);
+    return 0;
+}
+
+static void mlfq_on_remove(run_queue_t *rq, task_t *task) {
+    if (task->type == TASK_SHELL_COMMAND) heaps_remove(rq, task);
+    else mlfq_remove(&rq->program_levels, task);
+}
+
+// shell commands first unless a program's client has a smaller cpu penalty,
+// then programs from the highest non-empty level
+static task_t *mlfq_pick_next(run_queue_t *rq, long long now_ms) {
+    task_t *shell_task = task_heap_peek(&rq->shell_tasks);
+    mlfq_boost_if_due(&rq->program_levels, now_ms);
+    task_t *program_task = mlfq_peek(&rq->program_levels);
+    if (!shell_task || (program_task && program_task->penalty < shell_task->penalty)) return program_task;
+    return shell_task;
+}
+
+static int mlfq_policy_quantum(const run_queue_t *rq, const task_t *task) {
+    if (task->type == TASK_SHELL_COMMAND) return round_quantum(rq, task);
+    return mlfq_quantum(&rq->program_levels, task);
+}
+
+static void mlfq_on_quantum_end(run_queue_t *rq, task_t *task, int used_ms) {
+    mlfq_charge(&rq->program_levels, task, used_ms);
+}
+
+static int mlfq_runs_before(const task_t *a, const task_t *b) {
+    if (a->penalty != b->penalty) return a->penalty < b->penalty;
+    if (a->type != b->type) return a->type == TASK_SHELL_COMMAND;
+    if (a->type == TASK_SHELL_COMMAND) return a->id < b->id;
+    return a->level < b->level;
+}
+
+static const sched_policy_t policies[] = {
+    { SCHED_ALG_FIFO, "fifo", fifo_init, heaps_destroy, heaps_enqueue, fifo_pick_next,
+      heaps_remove, fifo_quantum, NULL, NULL, fifo_runs_before },
+    { SCHED_ALG_RR, "rr", rr_init, heaps_destroy, heaps_enqueue, shell_first_pick,
+      heaps_remove, round_quantum, NULL, NULL, rr_runs_before },
+    { SCHED_ALG_SJRF, "sjrf", sjrf_init, heaps_destroy, heaps_enqueue, sjrf_pick_next,
+      heaps_remove, round_quantum, NULL, sjrf_on_complete, sjrf_runs_before },
+    { SCHED_ALG_PRIORITY, "priority", priority_init, heaps_destroy, heaps_enqueue, priority_pick_next,
+      heaps_remove, round_quantum, NULL, NULL, priority_runs_before },
+    { SCHED_ALG_EDF, "edf", edf_init, heaps_destroy, heaps_enqueue, edf_pick_next,
+      heaps_remove, round_quantum, NULL, NULL, edf_runs_before },
+    { SCHED_ALG_MLFQ, "mlfq", mlfq_policy_init, heaps_destroy, mlfq_enqueue, mlfq_pick_next,
+      mlfq_on_remove, mlfq_policy_quantum, mlfq_on_quantum_end, NULL, mlfq_runs_before },
+};
+
+#define POLICY_COUNT (int)(sizeof(policies) / sizeof(policies[0]))
+
+const sched_policy_t *sched_policy_get(int id) {
+    for (int i = 0; i < POLICY_COUNT; i++) {
+        if (policies[i].id == id) return &policies[i];
+    }
+    return sched_policy_get(SCHED_ALG_SJRF);
+}
+
+const sched_policy_t *sched_policy_find(const char *name) {
+    for (int i = 0; i < POLICY_COUNT; i++) {
+        if (strcmp(policies[i].name, name) == 0) return &policies[i];
+    }
+    return NULL;
+}
+
+const char *sched_policy_names(void) {
+    return "fifo|rr|sjrf|priority|edf|mlfq";
+}
@@ -1,26 +1,76 @@
-#define _POSIX_C_SOURCE 200809L
+#define _GNU_SOURCE  // splice
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 #include <pthread.h>
 #include <time.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <sys/time.h>
+#include <sys/timerfd.h>
+#include <sys/eventfd.h>
 #include "scheduler.h"
+#include "run_queue.h"
 #include "parser.h"
 #include "executor.h"
 #include "pipes.h"
+#include "path_cache.h"
+#include "launcher.h"
+#include "estimator.h"
+#include "client_stats.h"
+#include "sched_core.h"
+#include <stddef.h>
 #include <sys/socket.h>
 
-#define FIRST_ROUND_QUANTUM 3
-#define OTHER_ROUNDS_QUANTUM 7
-#define MAX_TASKS 100
 #define BUFFER_SIZE 4096
+#define MAX_WORKERS 64
+#define DEMO_PROGRAM_PATH "./demo"
+// extra time granted on a program's last quantum so it can exit on its own
+#define PROGRAM_EXIT_GRACE_MS 500
+// how often an idle worker looks for work to steal without being woken
+#define IDLE_POLL_MS 100
+// most bytes moved from a pipe to a socket by one splice
+#define SPLICE_CHUNK (64 * 1024)
+// descriptors polled for them: output pipe and stage exit fds, plus the caller's
+#define INFLIGHT_POLL_FDS (WORKER_MAX_INFLIGHT * (MAX_COMMANDS + 1) + 4)
+// how often stages without an exit fd are checked for exit
+#define REAP_POLL_MS 10
+
+// whole seconds shown in the logs for a time kept in ms
+#define TASK_SECONDS(ms) (((ms) + 999) / 1000)
+
+// an executor thread, its run queue and the task it is currently running
+// submitters read the running task without locks, so the worker publishes a
+// copy of it under a sequence counter (a seqlock) that readers retry on.
+// shell commands are not running tasks in that sense, once started they are
+// in flight and serviced by the worker between its other work, like programs
+// whose output has not all reached the client when they end
+typedef struct {
+    pthread_t thread;
+    run_queue_t rq;           // tasks placed on this worker
+    task_t running;           // copy of the running task's scheduling keys
+    unsigned running_seq;     // odd while running is being rewritten
+    int busy;                 // whether running is valid, written with running
+    int preempt_requested;    // a more urgent task asked for this worker, accessed atomically
+    int idle;                 // sleeping until woken or the idle poll, accessed atomically
+    int timer_fd;             // timerfd that ends the running quantum
+    int wake_fd;              // eventfd that wakes an idle worker or preempts its quantum
+    task_t *inflight[WORKER_MAX_INFLIGHT]; // shell commands and ended programs not yet finished
+    int inflight_count;
+} worker_t;
 
 // global variables
 static task_queue_t *task_queue = NULL;
-static pthread_t scheduler_thread;
+static worker_t *workers = NULL;
+static int worker_count = 0;
 static int scheduler_running = 0;
 static int next_task_id = 1;
+static sched_host_t host;     // the workers as the shared scheduling decisions see them
 
 // color definitions
 #define COLOR_RED     "\033[1;31m"
@@ -32,350 +82,1070 @@ static int next_task_id = 1;
 // forward declarations of internal functions
 static void print_task_summary(void);
 static void send_to_client(task_t *task, const char *output, int send_prompt);
+static void stop_task_processes(task_t *task);
+static task_t *pick_next_task(worker_t *worker);
+static int read_running(worker_t *worker, task_t *copy);
+static void drop_task(task_t *task);
+static void free_task(task_t *task);
+static void wake_worker(worker_t *worker);
 void *scheduler_thread_func(void *arg);
 
+// milliseconds on the monotonic clock
+static long long monotonic_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// unlink a task from the submission list and free it, caller holds the queue
+// lock and the task is not waiting in a run queue
+static void free_task(task_t *task) {
+    if (task->prev) task->prev->next = task->next;
+    else task_queue->head = task->next;
+    if (task->next) task->next->prev = task->prev;
+    else task_queue->tail = task->prev;
+    task_queue->size--;
+    
+    if (task->rq) {
+        pthread_mutex_lock(&task->rq->lock);
+        run_queue_complete(task->rq, task);
+        pthread_mutex_unlock(&task->rq->lock);
+    }
+    stop_task_processes(task);
+    pipeline_plan_release(task->plan);
+    free(task->pending);
+    task_pool_free(&task_queue->pool, task);
+    pthread_cond_signal(&task_queue->not_full);
+}
+
 // prints the blue summary of tasks in format [client_id]-[remaining_time]
 static void print_task_summary(void) {
     pthread_mutex_lock(&task_queue->lock);
     printf(COLOR_BLUE);
     printf("[");
-    for (int i = 0; i < task_queue->size; i++) {
-        printf("[%d]-[%d]", task_queue->tasks[i]->client_id, 
-               task_queue->tasks[i]->remaining_time);
-        if (i < task_queue->size - 1) printf("-");
+    for (task_t *task = task_queue->head; task; task = task->next) {
+        printf("[%d]-[%d]", task->client_id, 
+               task->type == TASK_SHELL_COMMAND ? -1 : TASK_SECONDS(task->remaining_time));
+        if (task->next) printf("-");
     }
     printf("]\n" COLOR_RESET);
     pthread_mutex_unlock(&task_queue->lock);
 }
 
-// sends output to client and tracks bytes sent
+// queue output for the client behind what is already waiting for it
+static void queue_output(task_t *task, const char *output, size_t length) {
+    if (length == 0) return;
+    char *pending = realloc(task->pending, task->pending_length + length);
+    if (!pending) {
+        perror("realloc failed");
+        return;
+    }
+    memcpy(pending + task->pending_length, output, length);
+    task->pending = pending;
+    task->pending_length += length;
+}
+
+// send as much of the queued output as the client socket takes without
+// blocking and track bytes sent, returns 1 while some of it is left. what a
+// cancelled task or a client that is gone still had queued is dropped
+static int flush_pending(task_t *task) {
+    size_t sent = 0;
+    int dropped = task->cancelled;
+    while (sent < task->pending_length && !dropped) {
+        ssize_t sent_bytes = send(task->client_socket, task->pending + sent, task->pending_length - sent,
+                                  MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (sent_bytes > 0) {
+            task->bytes_sent += sent_bytes;
+            sent += sent_bytes;
+        } else if (sent_bytes < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        } else if (sent_bytes == 0 || errno != EINTR) {
+            dropped = 1;
+        }
+    }
+    if (dropped) sent = task->pending_length;
+    if (sent > 0) {
+        memmove(task->pending, task->pending + sent, task->pending_length - sent);
+        task->pending_length -= sent;
+    }
+    task->output_blocked = task->pending_length > 0;
+    return task->output_blocked;
+}
+
+// queue output for the client, followed by the prompt if asked, and send what
+// the socket takes right away. the rest goes out as the worker services the
+// task, so a client that does not read never holds the worker up
 static void send_to_client(task_t *task, const char *output, int send_prompt) {
     if (!output || !task) return;
-    ssize_t bytes_to_send = strlen(output);
-    ssize_t sent_bytes = send(task->client_socket, output, bytes_to_send, 0);
+    queue_output(task, output, strlen(output));
+    if (send_prompt) {
+        // a cancelled task's prompt went out with the cancel reply
+        if (!task->cancel_replied) queue_output(task, "$ ", 2);
+        task->replied = 1;
+    }
+    flush_pending(task);
+}
+
+// launch the process behind a program task, returns 0 on success
+static int start_program(task_t *task) {
+    static char demo_path[] = DEMO_PROGRAM_PATH;
+    char buffer[PARSE_ARENA_STACK_SIZE];
+    parse_arena_t arena;
+    if (parse_arena_reserve(&arena, buffer, sizeof(buffer), parse_arena_size(strlen(task->command))) != 0) {
+        return -1;
+    }
+    Command *cmd = parse_command(&arena, task->command);
+    if (!cmd) {
+        parse_arena_release(&arena);
+        return -1;
+    }
+    
+    // the demo binary is built next to the server
+    if (strcmp(cmd->args[0], "demo") == 0) cmd->args[0] = demo_path;
     
-    if (sent_bytes > 0) {
-        task->bytes_sent += sent_bytes;
+    int pipefd[2];
+    if (pipe(pipefd) != 0) {
+        perror("pipe");
+        parse_arena_release(&arena);
+        return -1;
     }
+    // keep other children from inheriting the pipe
+    fcntl(pipefd[0], F_SETFD, FD_CLOEXEC);
+    fcntl(pipefd[1], F_SETFD, FD_CLOEXEC);
+    // the worker only reads what is there
+    fcntl(pipefd[0], F_SETFL, O_NONBLOCK);
     
-    if (send_prompt) {
-        const char *prompt = "$ ";
-        send(task->client_socket, prompt, strlen(prompt), 0);
+    pid_t pid = launcher_spawn(cmd, -1, pipefd[1], pipefd[1], &task->exit_fd);
+    close(pipefd[1]);
+    parse_arena_release(&arena);
+    if (pid <= 0) {
+        close(pipefd[0]);
+        return -1;
     }
+    task->pid = pid;
+    task->output_fd = pipefd[0];
+    return 0;
+}
+
+// start a shell command with its output going to a pipe, returns 0 on success
+// a pipeline is one task, all of its stages start at once and write their
+// errors to the same pipe the last stage writes its output to
+static int start_shell_command(task_t *task) {
+    int pipefd[2];
+    if (pipe(pipefd) != 0) {
+        perror("pipe");
+        return -1;
+    }
+    // keep other children from inheriting the pipe
+    fcntl(pipefd[0], F_SETFD, FD_CLOEXEC);
+    fcntl(pipefd[1], F_SETFD, FD_CLOEXEC);
+    // the worker only reads what is there
+    fcntl(pipefd[0], F_SETFL, O_NONBLOCK);
+    
+    // only the children get the pipe as their stdout and stderr. a command
+    // that did not parse at submission is tried again, so the parse error
+    // goes down the pipe to its client
+    int started = task->plan ? spawn_plan(task->plan, -1, pipefd[1], pipefd[1],
+                                          task->stage_pids, task->stage_exit_fds)
+                             : spawn_pipeline(task->command, -1, pipefd[1], pipefd[1],
+                                              task->stage_pids, task->stage_exit_fds);
+    close(pipefd[1]);
+    
+    // the stages now hold the only write ends, end of output and every stage
+    // exiting means the command is done
+    task->stage_count = started > 0 ? started : 0;
+    task->output_fd = pipefd[0];
+    task->started_ms = monotonic_ms();
+    return 0;
+}
+
+// move what the task's process has written straight from the pipe into the
+// client socket, returns 1 if data moved or there is none yet, 0 at end of
+// output and -1 if the copy path has to take over. a full socket marks the
+// task blocked and leaves the data in the pipe. no SPLICE_F_MORE, that corks
+// the socket and holds partial output back from the client for up to 200ms
+static int splice_output(task_t *task) {
+    for (;;) {
+        ssize_t moved = splice(task->output_fd, NULL, task->client_socket, NULL,
+                               SPLICE_CHUNK, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+        if (moved > 0) {
+            task->bytes_sent += moved;
+            return 1;
+        }
+        if (moved == 0) return 0;
+        if (errno == EAGAIN) {
+            // the pipe is empty or the socket full, only the latter waits for the client
+            struct pollfd pfd = { .fd = task->client_socket, .events = POLLOUT };
+            task->output_blocked = poll(&pfd, 1, 0) == 0;
+            return 1;
+        }
+        if (errno != EINTR) return -1;
+    }
+}
+
+// forward whatever the task's process has written so far without blocking,
+// returns 0 at end of output. splice avoids copying through user space,
+// reading and queueing is the fallback when the kernel refuses or the client
+// is gone, so the pipe is still drained. while the client socket is full the
+// task is marked blocked and its output is left in the pipe, which holds the
+// process back instead of the worker. a cancelled task's output is dropped
+static int forward_output(task_t *task) {
+    if (flush_pending(task)) return 1;
+    if (!task->copy_output && !task->cancelled) {
+        int result = splice_output(task);
+        if (result >= 0) return result;
+        task->copy_output = 1;
+    }
+    char buffer[BUFFER_SIZE];
+    ssize_t bytes_read = read(task->output_fd, buffer, sizeof(buffer));
+    if (bytes_read > 0) {
+        queue_output(task, buffer, bytes_read);
+        flush_pending(task);
+        return 1;
+    }
+    if (bytes_read < 0 && (errno == EINTR || errno == EAGAIN)) return 1;
+    return 0;
+}
+
+// what the worker waits on to move a task's output along, the client socket
+// while it has no room and the output pipe otherwise. returns 0 for neither
+static int output_pollfd(const task_t *task, struct pollfd *pfd) {
+    if (task->output_blocked && !task->cancelled) {
+        *pfd = (struct pollfd){ .fd = task->client_socket, .events = POLLOUT };
+        return 1;
+    }
+    if (task->output_fd < 0) return 0;
+    *pfd = (struct pollfd){ .fd = task->output_fd, .events = POLLIN };
+    return 1;
+}
+
+// move a task's output along once its output_pollfd is ready, the output
+// pipe is closed at its end
+static void relay_output(task_t *task) {
+    if (task->output_fd < 0) {
+        flush_pending(task);
+    } else if (!forward_output(task)) {
+        close(task->output_fd);
+        task->output_fd = -1;
+    }
+}
+
+// add the resources a reaped process used to its task's
+static void add_usage(struct rusage *total, const struct rusage *usage) {
+    timeradd(&total->ru_utime, &usage->ru_utime, &total->ru_utime);
+    timeradd(&total->ru_stime, &usage->ru_stime, &total->ru_stime);
+    if (usage->ru_maxrss > total->ru_maxrss) total->ru_maxrss = usage->ru_maxrss;
+    total->ru_minflt += usage->ru_minflt;
+    total->ru_majflt += usage->ru_majflt;
+    total->ru_inblock += usage->ru_inblock;
+    total->ru_oublock += usage->ru_oublock;
+    total->ru_nvcsw += usage->ru_nvcsw;
+    total->ru_nivcsw += usage->ru_nivcsw;
+}
+
+// reap one of the task's processes if it has exited, adding up its resource
+// usage and storing its wait status. returns 1 once it is gone
+static int reap_process(task_t *task, pid_t pid, int *exit_fd, int options, int *status) {
+    struct rusage usage;
+    if (!launcher_reap(pid, exit_fd, options, status, &usage)) return 0;
+    add_usage(&task->usage, &usage);
+    return 1;
+}
+
+// reap the program if it has exited, returns 1 once it is gone
+static int reap_program(task_t *task, int options) {
+    int status = task->exit_status;
+    if (!reap_process(task, task->pid, &task->exit_fd, options, &status)) return 0;
+    task->exit_status = status;
+    task->pid = 0;
+    return 1;
+}
+
+// reap a stage of a shell command if it has exited, returns 1 once it is gone
+// only the last stage's status counts as the command's, like in a shell
+static int reap_stage(task_t *task, int stage, int options) {
+    int status = task->exit_status;
+    if (!reap_process(task, task->stage_pids[stage], &task->stage_exit_fds[stage], options, &status)) {
+        return 0;
+    }
+    if (stage == task->stage_count - 1) task->exit_status = status;
+    task->stage_pids[stage] = 0;
+    return 1;
+}
+
+// whether a task's output has ended and all its processes are reaped
+static int task_done(const task_t *task) {
+    if (task->output_fd >= 0 || task->pid > 0) return 0;
+    for (int i = 0; i < task->stage_count; i++) {
+        if (task->stage_pids[i] > 0) return 0;
+    }
+    return 1;
+}
+
+// hand the worker's finished in-flight tasks back to their clients. the
+// prompt is queued once a task's processes are done, and the task completes
+// once the client took everything queued for it
+static void finish_inflight(worker_t *worker) {
+    for (int i = worker->inflight_count - 1; i >= 0; i--) {
+        task_t *task = worker->inflight[i];
+        if (!task_done(task)) continue;
+        if (!task->replied) {
+            if (task->type == TASK_SHELL_COMMAND) {
+                record_execution_time(task->plan, (int)(monotonic_ms() - task->started_ms));
+            }
+            send_to_client(task, "", 1);
+        }
+        if (task->pending_length > 0) continue;
+        
+        worker->inflight[i] = worker->inflight[--worker->inflight_count];
+        printf("[%d]<<< %zu bytes sent\n", task->client_id, task->bytes_sent);
+        scheduler_complete_task(task);
+        print_task_summary();
+    }
+}
+
+// wait up to timeout_ms (-1 for no limit) for the caller's descriptors while
+// relaying the output of the worker's in-flight tasks and reaping the stages
+// of its shell commands as they exit. the caller's pollfds get their revents
+// filled in like poll would. cancelled commands are killed here and finished
+// tasks completed, so the worker never blocks on a single child or client.
+// stages without an exit fd are checked with WNOHANG every REAP_POLL_MS instead
+static void service_inflight(worker_t *worker, struct pollfd *extra, int extra_count, int timeout_ms) {
+    struct pollfd pfds[INFLIGHT_POLL_FDS];
+    task_t *owners[INFLIGHT_POLL_FDS];
+    int stages[INFLIGHT_POLL_FDS];      // stage an exit fd belongs to, -1 for the task's output
+    int count = 0;
+    finish_inflight(worker);
+    for (int i = 0; i < extra_count; i++) {
+        owners[count] = NULL;
+        pfds[count++] = extra[i];
+    }
+    int unwatched = 0;
+    for (int i = 0; i < worker->inflight_count; i++) {
+        task_t *task = worker->inflight[i];
+        for (int stage = 0; stage < task->stage_count; stage++) {
+            if (task->stage_pids[stage] <= 0) continue;
+            // a cancelled command is killed, its remaining output is dropped
+            if (task->cancelled && !reap_stage(task, stage, WNOHANG)) {
+                launcher_signal(task->stage_pids[stage], task->stage_exit_fds[stage], SIGKILL);
+            }
+            if (task->stage_pids[stage] <= 0) continue;
+            if (task->stage_exit_fds[stage] < 0) {
+                unwatched = 1;
+                continue;
+            }
+            owners[count] = task;
+            stages[count] = stage;
+            pfds[count++] = (struct pollfd){ .fd = task->stage_exit_fds[stage], .events = POLLIN };
+        }
+        if (output_pollfd(task, &pfds[count])) {
+            owners[count] = task;
+            stages[count++] = -1;
+        }
+    }
+    if (unwatched && (timeout_ms < 0 || timeout_ms > REAP_POLL_MS)) timeout_ms = REAP_POLL_MS;
+    
+    int ready = poll(pfds, count, timeout_ms);
+    // a worker waiting for work is only idle while it sleeps, placing tasks
+    // on it while it relays output would leave them waiting behind that
+    __atomic_store_n(&worker->idle, 0, __ATOMIC_SEQ_CST);
+    for (int i = 0; i < extra_count; i++) {
+        extra[i].revents = ready > 0 ? pfds[i].revents : 0;
+    }
+    for (int i = extra_count; ready > 0 && i < count; i++) {
+        task_t *task = owners[i];
+        if (!pfds[i].revents) continue;
+        if (stages[i] >= 0) reap_stage(task, stages[i], WNOHANG);
+        else relay_output(task);
+    }
+    
+    if (unwatched) {
+        for (int i = 0; i < worker->inflight_count; i++) {
+            task_t *task = worker->inflight[i];
+            for (int stage = 0; stage < task->stage_count; stage++) {
+                if (task->stage_pids[stage] > 0 && task->stage_exit_fds[stage] < 0) {
+                    reap_stage(task, stage, WNOHANG);
+                }
+            }
+        }
+    }
+    finish_inflight(worker);
+}
+
+// hand a task that will not run again to the worker's in-flight tasks, which
+// relay the rest of its output and complete it. a worker only picks a task
+// while it has room for one more in flight
+static void finish_task(worker_t *worker, task_t *task) {
+    // a cancelled program is killed, what it still had to say is dropped
+    if (task->cancelled) stop_task_processes(task);
+    worker->inflight[worker->inflight_count++] = task;
+}
+
+// resume the program for one quantum, forwarding its output as it is
+// produced, then preempt it again. the quantum ends when the worker's timer
+// expires or a more urgent task wakes the worker. the worker's in-flight
+// shell commands are serviced meanwhile. returns 1 if the program exited,
+// the time it ran for is stored in executed_ms
+static int run_program_quantum(worker_t *worker, task_t *task, int quantum_ms, int *executed_ms) {
+    // the last quantum gets a grace period so the program can exit on its own
+    if (quantum_ms >= task->remaining_time) quantum_ms += PROGRAM_EXIT_GRACE_MS;
+    
+    // drop stale wakeups, but keep a preemption requested since the pick
+    uint64_t wakeups;
+    while (read(worker->wake_fd, &wakeups, sizeof(wakeups)) > 0) {}
+    if (__atomic_load_n(&worker->preempt_requested, __ATOMIC_SEQ_CST)) wake_worker(worker);
+    
+    struct itimerspec quantum = {0};
+    quantum.it_value.tv_sec = quantum_ms / 1000;
+    quantum.it_value.tv_nsec = (quantum_ms % 1000) * 1000000L;
+    timerfd_settime(worker->timer_fd, 0, &quantum, NULL);
+    
+    long long started = monotonic_ms();
+    // a program that exited while stopped just has its output drained
+    launcher_signal(task->pid, task->exit_fd, SIGCONT);
+    
+    int output_open = 1;
+    int expired = 0;
+    while (output_open && !expired) {
+        struct pollfd pfds[3] = {
+            { .fd = -1 },
+            { .fd = worker->timer_fd, .events = POLLIN },
+            { .fd = worker->wake_fd, .events = POLLIN },
+        };
+        output_pollfd(task, &pfds[0]);
+        service_inflight(worker, pfds, 3, -1);
+        if (pfds[0].revents) output_open = forward_output(task);
+        if (pfds[1].revents || pfds[2].revents) expired = 1;
+    }
+    if (!output_open) {
+        close(task->output_fd);
+        task->output_fd = -1;
+    }
+    
+    // disarm the timer and clear it in case it fired alongside a preemption
+    struct itimerspec disarm = {0};
+    timerfd_settime(worker->timer_fd, 0, &disarm, NULL);
+    uint64_t expirations;
+    while (read(worker->timer_fd, &expirations, sizeof(expirations)) > 0) {}
+    
+    // end of output means the program is exiting, one that has not exited
+    // yet still has a live pid to stop
+    int exited = !output_open ? reap_program(task, 0) : reap_program(task, WNOHANG);
+    if (!exited) launcher_signal(task->pid, task->exit_fd, SIGSTOP);
+    
+    *executed_ms = (int)(monotonic_ms() - started);
+    return exited;
+}
+
+// kill the processes of a task that will not run again and release its pipe
+// processes that already exited are only collected
+static void stop_task_processes(task_t *task) {
+    if (task->pid > 0 && !reap_program(task, WNOHANG)) {
+        launcher_signal(task->pid, task->exit_fd, SIGKILL);
+        reap_program(task, 0);
+    }
+    for (int i = 0; i < task->stage_count; i++) {
+        if (task->stage_pids[i] <= 0 || reap_stage(task, i, WNOHANG)) continue;
+        launcher_signal(task->stage_pids[i], task->stage_exit_fds[i], SIGKILL);
+        reap_stage(task, i, 0);
+    }
+    if (task->output_fd >= 0) {
+        close(task->output_fd);
+        task->output_fd = -1;
+    }
+}
+
+// the hooks the shared scheduling decisions call
+
+static long long host_now_ms(void *ctx) {
+    (void)ctx;
+    return monotonic_ms();
+}
+
+static run_queue_t *host_queue(void *ctx, int worker) {
+    (void)ctx;
+    return &workers[worker].rq;
+}
+
+static int host_idle(void *ctx, int worker) {
+    (void)ctx;
+    return __atomic_load_n(&workers[worker].idle, __ATOMIC_SEQ_CST);
+}
+
+static int host_running(void *ctx, int worker, task_t *copy) {
+    (void)ctx;
+    return !__atomic_load_n(&workers[worker].preempt_requested, __ATOMIC_SEQ_CST) &&
+           read_running(&workers[worker], copy);
+}
+
+// another submission may have claimed the worker meanwhile
+static int host_preempt(void *ctx, int worker) {
+    (void)ctx;
+    return !__atomic_exchange_n(&workers[worker].preempt_requested, 1, __ATOMIC_SEQ_CST);
+}
+
+static void host_drop(void *ctx, task_t *task) {
+    (void)ctx;
+    drop_task(task);
 }
 
 // initialize the scheduler
-void scheduler_init(void) {
+void scheduler_init(const scheduler_config_t *config) {
+    scheduler_config_t defaults;
+    if (!config) {
+        scheduler_config_defaults(&defaults);
+        config = &defaults;
+    }
+    
+    // fork the launch helper while the server is still small and single threaded
+    if (launcher_start() != 0) {
+        fprintf(stderr, "launch helper unavailable, spawning commands in process\n");
+    }
+    
+    // one worker per online cpu unless told otherwise
+    client_stats_init(config->cpu_penalty_ms);
+    worker_count = config->num_workers;
+    if (worker_count <= 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        worker_count = cpus > 0 ? (int)cpus : 1;
+    }
+    if (worker_count > MAX_WORKERS) worker_count = MAX_WORKERS;
+    host = (sched_host_t){ worker_count, NULL, host_now_ms, host_queue, host_idle, host_running,
+                           host_preempt, host_drop };
+    
     task_queue = malloc(sizeof(task_queue_t));
     if (!task_queue) {
         perror("malloc failed for task queue");
         exit(EXIT_FAILURE);
     }
     
-    task_queue->tasks = malloc(MAX_TASKS * sizeof(task_t *));
-    if (!task_queue->tasks) {
-        free(task_queue);
-        perror("malloc failed for tasks array");
-        exit(EXIT_FAILURE);
-    }
-    
-    task_queue->capacity = MAX_TASKS;
+    task_queue->head = NULL;
+    task_queue->tail = NULL;
+    task_pool_init(&task_queue->pool);
+    task_queue->max_tasks = config->max_tasks > 0 ? config->max_tasks : 0;
+    task_queue->admission = config->admission;
     task_queue->size = 0;
     task_queue->current_round = 1;
     
     if (pthread_mutex_init(&task_queue->lock, NULL) != 0) {
-        free(task_queue->tasks);
         free(task_queue);
         perror("mutex init failed");
         exit(EXIT_FAILURE);
     }
     
-    if (pthread_cond_init(&task_queue->not_empty, NULL) != 0) {
-        pthread_mutex_destroy(&task_queue->lock);
-        free(task_queue->tasks);
-        free(task_queue);
+    if (pthread_cond_init(&task_queue->task_done, NULL) != 0 ||
+        pthread_cond_init(&task_queue->not_full, NULL) != 0) {
         perror("condition variable init failed");
         exit(EXIT_FAILURE);
     }
     
-    scheduler_start();
+    // every worker gets its own run queue, the threads start in scheduler_start
+    workers = calloc(worker_count, sizeof(worker_t));
+    if (!workers) {
+        perror("malloc failed for workers");
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < worker_count; i++) {
+        if (run_queue_init(&workers[i].rq, config, monotonic_ms()) != 0) {
+            perror("run queue init failed");
+            exit(EXIT_FAILURE);
+        }
+        workers[i].timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+        workers[i].wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (workers[i].timer_fd < 0 || workers[i].wake_fd < 0) {
+            perror("failed to create worker timers");
+            exit(EXIT_FAILURE);
+        }
+    }
 }
 
 // clean up scheduler resources
 void scheduler_cleanup(void) {
     if (task_queue) {
-        for (int i = 0; i < task_queue->size; i++) {
-            if (task_queue->tasks[i]) {
-                free(task_queue->tasks[i]->command);
-                free(task_queue->tasks[i]);
+        // waiting tasks still sit in their run queues
+        for (int i = 0; i < worker_count; i++) {
+            pthread_mutex_lock(&workers[i].rq.lock);
+            run_queue_drain(&workers[i].rq);
+            for (task_t *task = task_queue->head; task; task = task->next) {
+                run_queue_remove(&workers[i].rq, task);
             }
+            pthread_mutex_unlock(&workers[i].rq.lock);
+        }
+        while (task_queue->head) {
+            free_task(task_queue->head);
         }
+        for (int i = 0; i < worker_count; i++) {
+            run_queue_destroy(&workers[i].rq);
+            close(workers[i].timer_fd);
+            close(workers[i].wake_fd);
+        }
+        free(workers);
+        workers = NULL;
+        
         pthread_mutex_destroy(&task_queue->lock);
-        pthread_cond_destroy(&task_queue->not_empty);
-        free(task_queue->tasks);
+        pthread_cond_destroy(&task_queue->task_done);
+        pthread_cond_destroy(&task_queue->not_full);
+        task_pool_destroy(&task_queue->pool);
         free(task_queue);
+        estimator_cleanup();
+        client_stats_cleanup();
+        pipeline_cache_cleanup();
+        path_cache_cleanup();
+        launcher_stop();
         task_queue = NULL;
     }
 }
 
-// start the scheduler thread
+// start the executor worker threads
 void scheduler_start(void) {
+    if (scheduler_running) return;
+    
     scheduler_running = 1;
-    if (pthread_create(&scheduler_thread, NULL, scheduler_thread_func, NULL) != 0) {
-        perror("failed to create scheduler thread");
-        exit(EXIT_FAILURE);
+    for (int i = 0; i < worker_count; i++) {
+        if (pthread_create(&workers[i].thread, NULL, scheduler_thread_func, &workers[i]) != 0) {
+            perror("failed to create scheduler thread");
+            exit(EXIT_FAILURE);
+        }
     }
+    printf("| Scheduler running %d worker(s), %s policy |\n", worker_count, workers[0].rq.policy->name);
+}
+
+// wake a worker sleeping idle or interrupt its quantum
+static void wake_worker(worker_t *worker) {
+    uint64_t wakeup = 1;
+    if (write(worker->wake_fd, &wakeup, sizeof(wakeup)) < 0) {
+        perror("failed to wake worker");
+    }
+}
+
+// the worker owning a run queue
+static worker_t *worker_of(run_queue_t *rq) {
+    return (worker_t *)((char *)rq - offsetof(worker_t, rq));
 }
 
-// stop the scheduler thread
+// stop the executor worker threads
 void scheduler_stop(void) {
-    scheduler_running = 0;
-    pthread_cond_signal(&task_queue->not_empty);
-    pthread_join(scheduler_thread, NULL);
+    if (!scheduler_running) return;
+    
+    pthread_mutex_lock(&task_queue->lock);
+    __atomic_store_n(&scheduler_running, 0, __ATOMIC_SEQ_CST);
+    pthread_cond_broadcast(&task_queue->not_full);
+    pthread_mutex_unlock(&task_queue->lock);
+    
+    for (int i = 0; i < worker_count; i++) {
+        wake_worker(&workers[i]);
+    }
+    for (int i = 0; i < worker_count; i++) {
+        pthread_join(workers[i].thread, NULL);
+    }
+}
+
+// an idle worker other than the given one, or NULL if all are busy
+static worker_t *find_idle_worker(const worker_t *except) {
+    for (int i = 0; i < worker_count; i++) {
+        if (&workers[i] != except && __atomic_load_n(&workers[i].idle, __ATOMIC_SEQ_CST)) {
+            return &workers[i];
+        }
+    }
+    return NULL;
+}
+
+// publish the task a worker is running, NULL when it runs nothing
+static void publish_running(worker_t *worker, const task_t *task) {
+    unsigned seq = worker->running_seq;
+    __atomic_store_n(&worker->running_seq, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    if (task) worker->running = *task;
+    __atomic_store_n(&worker->busy, task != NULL, __ATOMIC_RELAXED);
+    __atomic_store_n(&worker->running_seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+// read the task a worker is running into copy, returns 0 when it runs nothing
+static int read_running(worker_t *worker, task_t *copy) {
+    unsigned before, after;
+    int busy;
+    do {
+        before = __atomic_load_n(&worker->running_seq, __ATOMIC_ACQUIRE);
+        busy = __atomic_load_n(&worker->busy, __ATOMIC_RELAXED);
+        if (busy) *copy = worker->running;
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        after = __atomic_load_n(&worker->running_seq, __ATOMIC_RELAXED);
+    } while ((before & 1) || before != after);
+    return busy;
 }
 
 // add a task to the scheduler queue
-void scheduler_add_task(int client_id, int client_socket, const char *command, int type, int exec_time) {
+int scheduler_add_task(int client_id, int client_socket, const char *command, int type, int exec_time,
+                       int priority, int deadline_ms) {
+    // shell commands are parsed once here and timed from the history of
+    // similar commands, the worker spawns them from the same plan
+    pipeline_plan_t *plan = type == TASK_SHELL_COMMAND ? pipeline_plan_get(command, -1) : NULL;
+    int time_ms = type == TASK_SHELL_COMMAND ? estimate_execution_time(plan) : exec_time * 1000;
+    
     pthread_mutex_lock(&task_queue->lock);
     
-    if (task_queue->size >= task_queue->capacity) {
-        printf("task queue is full\n");
-        pthread_mutex_unlock(&task_queue->lock);
-        return;
+    // admission control once the queue reaches its configured limit
+    while (task_queue->max_tasks > 0 && task_queue->size >= task_queue->max_tasks) {
+        if (task_queue->admission != ADMISSION_BLOCK || !scheduler_running) {
+            printf("[%d]--- " COLOR_RED "rejected" COLOR_RESET " (queue full)\n", client_id);
+            pthread_mutex_unlock(&task_queue->lock);
+            pipeline_plan_release(plan);
+            return -1;
+        }
+        pthread_cond_wait(&task_queue->not_full, &task_queue->lock);
     }
     
-    task_t *task = malloc(sizeof(task_t));
+    task_t *task = task_pool_alloc(&task_queue->pool, command);
     if (!task) {
         perror("malloc failed");
         pthread_mutex_unlock(&task_queue->lock);
-        return;
+        pipeline_plan_release(plan);
+        return -1;
     }
     // initialize task properties
     task->id = next_task_id++;
-    task->client_id = client_id;
+    task->plan = plan;
+    sched_prepare_task(task, client_id, type, time_ms, priority, deadline_ms, monotonic_ms());
     task->client_socket = client_socket;
-    task->type = type;
-    task->command = strdup(command);
-    task->total_time = exec_time;
-    task->remaining_time = exec_time;
-    task->state = TASK_STATE_WAITING;
-    task->round = 1;
-    task->last_executed = 0;
     task->arrival_time = time(NULL);
-    task->preempted = 0;
     task->bytes_sent = 0;
-    // add task to queue
-    task_queue->tasks[task_queue->size++] = task;
+    task->cancelled = 0;
+    task->cancel_replied = 0;
+    task->pid = 0;
+    task->stage_count = 0;
+    task->exit_fd = -1;
+    task->exit_status = -1;
+    memset(&task->usage, 0, sizeof(task->usage));
+    task->output_fd = -1;
+    // add task to the end of the submission list
+    task->next = NULL;
+    task->prev = task_queue->tail;
+    if (task_queue->tail) task_queue->tail->next = task;
+    else task_queue->head = task;
+    task_queue->tail = task;
+    task_queue->size++;
+    pthread_mutex_unlock(&task_queue->lock);
     
     printf("[%d]>>> %s\n", client_id, command);
     printf("[%d]--- " COLOR_GREEN "created" COLOR_RESET " (%d)\n", 
            client_id, type == TASK_SHELL_COMMAND ? -1 : exec_time);
-    // notify scheduler that a new task is available
-    pthread_cond_signal(&task_queue->not_empty);
-    pthread_mutex_unlock(&task_queue->lock);
-}
-
-// get next task based on scheduling algorithm
-task_t *scheduler_get_next_task(void) {
-    pthread_mutex_lock(&task_queue->lock);
-    // wait until there is a task available
-    while (task_queue->size == 0) {
-        pthread_cond_wait(&task_queue->not_empty, &task_queue->lock);
+    if (task->penalty > 0) {
+        printf("[%d]--- " COLOR_YELLOW "deprioritized" COLOR_RESET " (priority %d, cpu penalty %d)\n",
+               client_id, task->priority, task->penalty);
     }
     
-    task_t *selected_task = NULL;
+    // tell the client the id it can cancel the task with, ahead of any of
+    // the task's output since no worker has the task yet
+    char accepted[32];
+    snprintf(accepted, sizeof(accepted), "[task %d]\n", task->id);
+    send_to_client(task, accepted, 0);
     
-    // first priority: shell commands get highest priority
-    for (int i = 0; i < task_queue->size; i++) {
-        if (task_queue->tasks[i]->type == TASK_SHELL_COMMAND && 
-            task_queue->tasks[i]->state == TASK_STATE_WAITING) {
-            selected_task = task_queue->tasks[i];
-            break;
-        }
-    }
+    // and to a worker's run queue, without taking its lock
+    int preempt;
+    worker_t *worker = &workers[sched_place(&host, task, &preempt)];
+    run_queue_submit(&worker->rq, task);
     
-    // second priority: shortest remaining time first (sjrf)
-    if (!selected_task) {
-        int shortest_time = -1;
-        for (int i = 0; i < task_queue->size; i++) {
-            task_t *task = task_queue->tasks[i];
-            if (task->state == TASK_STATE_WAITING) {
-                // prevent consecutive execution unless it's the only task
-                if (task->last_executed && task_queue->size > 1) continue;
-                
-                if (shortest_time == -1 || task->remaining_time < shortest_time) {
-                    shortest_time = task->remaining_time;
-                    selected_task = task;
-                }
-            }
-        }
-    }
-    // third priority: round robin for remaining tasks
-    if (selected_task) {
-        selected_task->state = TASK_STATE_RUNNING;
-        for (int i = 0; i < task_queue->size; i++) {
-            task_queue->tasks[i]->last_executed = 0;
+    // notify the worker that a new task is available
+    if (preempt || __atomic_load_n(&worker->idle, __ATOMIC_SEQ_CST)) wake_worker(worker);
+    return 0;
+}
+
+// give up on a task that would finish too late instead of running it
+// the notice is not waited for, a client whose socket is full misses it
+static void drop_task(task_t *task) {
+    printf("[%d]--- " COLOR_RED "dropped" COLOR_RESET " (deadline)\n", task->client_id);
+    send_to_client(task, "Error: task cannot meet its deadline, dropped.\n", 1);
+    scheduler_complete_task(task);
+}
+
+// get next task for a worker, which is recorded as running it
+// sched_next_task looks in the worker's own queue first, then its peers'
+// queues, and drops tasks that can no longer meet their deadline. when there
+// is nothing to run, or the worker already has all the shell commands in
+// flight it can service, it services those until woken or until the idle
+// poll interval passes. returns NULL once the scheduler stops
+static task_t *pick_next_task(worker_t *worker) {
+    run_queue_t *rq = &worker->rq;
+    
+    while (__atomic_load_n(&scheduler_running, __ATOMIC_SEQ_CST)) {
+        publish_running(worker, NULL);
+        __atomic_store_n(&worker->preempt_requested, 0, __ATOMIC_SEQ_CST);
+        int full = worker->inflight_count >= WORKER_MAX_INFLIGHT;
+        task_t *selected_task = full ? NULL : sched_next_task(&host, (int)(worker - workers));
+        if (selected_task) {
+            publish_running(worker, selected_task);
+            
+            printf("[%d]--- " COLOR_GREEN "started" COLOR_RESET " (%d)\n", 
+                   selected_task->client_id, 
+                   selected_task->type == TASK_SHELL_COMMAND ? -1 : TASK_SECONDS(selected_task->remaining_time));
+            return selected_task;
         }
-        selected_task->last_executed = 1;
         
-        printf("[%d]--- " COLOR_GREEN "started" COLOR_RESET " (%d)\n", 
-               selected_task->client_id, 
-               selected_task->type == TASK_SHELL_COMMAND ? -1 : selected_task->remaining_time);
+        // announce the worker as idle before the last look at its queue, so a
+        // task placed concurrently is either seen here or followed by a wakeup.
+        // service_inflight withdraws it as soon as its poll returns, a task
+        // placed after that is picked on the next pass of this loop
+        if (!full) __atomic_store_n(&worker->idle, 1, __ATOMIC_SEQ_CST);
+        if (full || (run_queue_length(rq) == 0 && __atomic_load_n(&scheduler_running, __ATOMIC_SEQ_CST))) {
+            struct pollfd pfd = { .fd = worker->wake_fd, .events = POLLIN };
+            service_inflight(worker, &pfd, 1, IDLE_POLL_MS);
+            uint64_t wakeups;
+            while (read(worker->wake_fd, &wakeups, sizeof(wakeups)) > 0) {}
+        }
+        __atomic_store_n(&worker->idle, 0, __ATOMIC_SEQ_CST);
     }
-    // remove the selected task from the queue
-    pthread_mutex_unlock(&task_queue->lock);
-    return selected_task;
+    return NULL;
+}
+
+// log how a task's processes ended and what they used
+static void print_task_usage(const task_t *task, long long wall_ms) {
+    char outcome[32];
+    if (WIFSIGNALED(task->exit_status)) {
+        snprintf(outcome, sizeof(outcome), "signal %d", WTERMSIG(task->exit_status));
+    } else {
+        snprintf(outcome, sizeof(outcome), "status %d", WEXITSTATUS(task->exit_status));
+    }
+    printf("[%d]--- exited (%s, user %ld.%03lds, sys %ld.%03lds, maxrss %ldKB, csw %ld/%ld, "
+           "wait %lldms, wall %lldms)\n",
+           task->client_id, outcome,
+           (long)task->usage.ru_utime.tv_sec, (long)task->usage.ru_utime.tv_usec / 1000,
+           (long)task->usage.ru_stime.tv_sec, (long)task->usage.ru_stime.tv_usec / 1000,
+           task->usage.ru_maxrss, task->usage.ru_nvcsw, task->usage.ru_nivcsw,
+           task->wait_ms, wall_ms);
 }
 
 // mark a task as completed and remove it from queue
+// its usage and timing are added to the client's totals
 void scheduler_complete_task(task_t *task) {
+    long long wall_ms = sched_record_completion(task, monotonic_ms());
+    
     pthread_mutex_lock(&task_queue->lock);
     
-    int task_index = -1;
-    for (int i = 0; i < task_queue->size; i++) {
-        if (task_queue->tasks[i] == task) {
-            task_index = i;
-            break;
-        }
-    }
+    task->state = TASK_STATE_COMPLETED;
+    if (task->exit_status != -1) print_task_usage(task, wall_ms);
+    printf("[%d]--- " COLOR_RED "ended" COLOR_RESET " (%d)\n", 
+           task->client_id, task->type == TASK_SHELL_COMMAND ? -1 : TASK_SECONDS(task->remaining_time));
     
-    if (task_index != -1) {
-        task->state = TASK_STATE_COMPLETED;
-        printf("[%d]--- " COLOR_RED "ended" COLOR_RESET " (%d)\n", 
-               task->client_id, task->type == TASK_SHELL_COMMAND ? -1 : task->remaining_time);
-        
-        free(task->command);
-        free(task);
-        
-        for (int i = task_index; i < task_queue->size - 1; i++) {
-            task_queue->tasks[i] = task_queue->tasks[i + 1];
-        }
-        task_queue->size--;
-    }
+    free_task(task);
+    pthread_cond_broadcast(&task_queue->task_done);
     
     pthread_mutex_unlock(&task_queue->lock);
 }
 
 // remove all tasks belonging to a specific client
+// tasks a worker is currently running are flagged as cancelled and this call
+// waits for the worker to finish with them, so the caller can safely close
+// the client socket afterwards
 void scheduler_remove_client_tasks(int client_id) {
     pthread_mutex_lock(&task_queue->lock);
     
-    int i = 0;
-    while (i < task_queue->size) {
-        if (task_queue->tasks[i]->client_id == client_id) {
-            free(task_queue->tasks[i]->command);
-            free(task_queue->tasks[i]);
-            
-            for (int j = i; j < task_queue->size - 1; j++) {
-                task_queue->tasks[j] = task_queue->tasks[j + 1];
+    int running = 1;
+    while (running) {
+        running = 0;
+        task_t *task = task_queue->head;
+        while (task) {
+            task_t *next = task->next;
+            if (task->client_id == client_id) {
+                // the task may be picked or stolen concurrently, its state
+                // is only stable under the lock of the run queue it is in
+                run_queue_t *rq = task->rq;
+                int waiting = 0;
+                if (rq) {
+                    pthread_mutex_lock(&rq->lock);
+                    run_queue_drain(rq);
+                }
+                if (task->state == TASK_STATE_WAITING && task->rq == rq) {
+                    run_queue_remove(rq, task);
+                    waiting = 1;
+                } else {
+                    task->cancelled = 1;
+                    running = 1;
+                }
+                if (rq) pthread_mutex_unlock(&rq->lock);
+                if (waiting) free_task(task);
+                // cut the running quantum or shell command short
+                else if (rq) wake_worker(worker_of(rq));
             }
-            task_queue->size--;
-        } else {
-            i++;
+            task = next;
+        }
+        if (running) {
+            pthread_cond_wait(&task_queue->task_done, &task_queue->lock);
         }
     }
     
     pthread_mutex_unlock(&task_queue->lock);
+    client_stats_forget(client_id);
 }
 
-// update task state after execution
-void scheduler_update_task(task_t *task, int time_executed) {
+// cancel a single task of a client
+int scheduler_cancel_task(int client_id, int task_id) {
     pthread_mutex_lock(&task_queue->lock);
     
-    if (task->type == TASK_PROGRAM) {
-        task->remaining_time -= time_executed;
-        if (task->remaining_time > 0) {
-            task->state = TASK_STATE_WAITING;
-            task->round++;
-            task->preempted = 1;
-            printf("[%d]--- " COLOR_YELLOW "waiting" COLOR_RESET " (%d)\n", 
-                   task->client_id, task->remaining_time);
-        }
+    task_t *task = task_queue->head;
+    while (task && (task->id != task_id || task->client_id != client_id)) {
+        task = task->next;
+    }
+    if (!task) {
+        pthread_mutex_unlock(&task_queue->lock);
+        return -1;
+    }
+    
+    // a waiting task goes right away, a running one once its quantum is cut short
+    run_queue_t *rq = task->rq;
+    int waiting = 0;
+    if (rq) {
+        pthread_mutex_lock(&rq->lock);
+        run_queue_drain(rq);
+    }
+    if (task->state == TASK_STATE_WAITING && task->rq == rq) {
+        run_queue_remove(rq, task);
+        waiting = 1;
+    } else {
+        task->cancelled = 1;
+        task->cancel_replied = 1;
+    }
+    if (rq) pthread_mutex_unlock(&rq->lock);
+    
+    printf("[%d]--- " COLOR_RED "cancelled" COLOR_RESET " (task %d)\n", client_id, task_id);
+    if (waiting) {
+        free_task(task);
+        pthread_cond_broadcast(&task_queue->task_done);
+    } else if (rq) {
+        wake_worker(worker_of(rq));
     }
     
     pthread_mutex_unlock(&task_queue->lock);
+    return 0;
 }
 
-// main scheduler thread implementation
+// describe a client's tasks
+int scheduler_list_client_tasks(int client_id, char *buffer, size_t size) {
+    static const char *state_names[] = { "waiting", "running", "completed", "waiting" };
+    size_t used = 0;
+    int listed = 0;
+    buffer[0] = '\0';
+    
+    pthread_mutex_lock(&task_queue->lock);
+    long long now = monotonic_ms();
+    for (task_t *task = task_queue->head; task && used < size; task = task->next) {
+        if (task->client_id != client_id) continue;
+        int written = snprintf(buffer + used, size - used, "%5d  %-9s", task->id, 
+                               state_names[task->state]);
+        if (written > 0 && (size_t)written < size - used && task->deadline_ms > 0) {
+            used += written;
+            written = snprintf(buffer + used, size - used, "  due in %lldms", task->deadline_ms - now);
+        }
+        if (written > 0 && (size_t)written < size - used) {
+            used += written;
+            written = snprintf(buffer + used, size - used, "  %s\n", task->command);
+        }
+        if (written < 0 || (size_t)written >= size - used) {
+            // out of room, keep whole lines only
+            char *last_line = strrchr(buffer, '\n');
+            used = last_line ? (size_t)(last_line - buffer) + 1 : 0;
+            buffer[used] = '\0';
+            break;
+        }
+        used += written;
+        listed++;
+    }
+    pthread_mutex_unlock(&task_queue->lock);
+    return listed;
+}
+
+// describe the resources used by a client's completed tasks
+int scheduler_client_usage(int client_id, char *buffer, size_t size) {
+    client_usage_t usage;
+    long long now = monotonic_ms();
+    if (client_stats_get(client_id, &usage, now) != 0) return -1;
+    snprintf(buffer, size,
+             "tasks     %d\n"
+             "user      %lld.%03llds\n"
+             "sys       %lld.%03llds\n"
+             "maxrss    %ldKB\n"
+             "csw       %ld voluntary, %ld involuntary\n"
+             "wait      %lldms\n"
+             "wall      %lldms\n"
+             "recent    %lldms cpu, priority penalty %d\n",
+             usage.tasks, usage.user_us / 1000000, usage.user_us / 1000 % 1000,
+             usage.sys_us / 1000000, usage.sys_us / 1000 % 1000, usage.maxrss_kb,
+             usage.nvcsw, usage.nivcsw, usage.wait_ms, usage.wall_ms,
+             usage.recent_cpu_us / 1000, client_stats_penalty(client_id, now));
+    return 0;
+}
+
+// update task state after execution, returns 1 if the task was requeued
+// a requeued task may be picked by another worker right away, so the caller
+// must not touch it afterwards
+int scheduler_update_task(task_t *task, int time_executed) {
+    if (task->type != TASK_PROGRAM) return 0;
+    
+    run_queue_t *rq = task->rq;
+    pthread_mutex_lock(&rq->lock);
+    int requeued = sched_quantum_end(task, time_executed, monotonic_ms());
+    if (requeued < 0) {
+        // no room to requeue, let the worker finish the task off
+        perror("malloc failed");
+        task->cancelled = 1;
+        requeued = 0;
+    } else if (requeued) {
+        printf("[%d]--- " COLOR_YELLOW "waiting" COLOR_RESET " (%d)\n", 
+               task->client_id, TASK_SECONDS(task->remaining_time));
+    }
+    int waiting = rq->waiting;
+    pthread_mutex_unlock(&rq->lock);
+    
+    // let an idle peer take the tasks this worker will not get to next
+    if (waiting > 1) {
+        worker_t *idle = find_idle_worker(NULL);
+        if (idle) wake_worker(idle);
+    }
+    return requeued;
+}
+
+// executor worker implementation, every worker runs this loop over its own
+// run queue and steals from its peers when that is empty
 void *scheduler_thread_func(void *arg) {
-    (void)arg; // unused parameter
+    worker_t *worker = arg;
     
-    while (scheduler_running) {
-        // wait for tasks to be available
-        task_t *task = scheduler_get_next_task();
-        if (!task) continue;
+    while (1) {
+        // wait for tasks to be available, NULL means the scheduler stopped
+        task_t *task = pick_next_task(worker);
+        if (!task) break;
 
-        int quantum = (task->round == 1) ? FIRST_ROUND_QUANTUM : OTHER_ROUNDS_QUANTUM;
         // handle shell commands and programs differently
         if (task->type == TASK_SHELL_COMMAND) {
-            int stdout_backup = dup(STDOUT_FILENO);
-            int stderr_backup = dup(STDERR_FILENO);
-            int pipefd[2];
-            pipe(pipefd);
-             // redirect stdout and stderr to the pipe
-            dup2(pipefd[1], STDOUT_FILENO);
-            dup2(pipefd[1], STDERR_FILENO);
-            close(pipefd[1]);
-            
-            Command *cmd = parse_command(task->command);
-            if (cmd) {
-                execute_command(cmd);
-                free_command(cmd);
-            }
-            // flush the pipe to ensure all output is sent
-            fflush(stdout);
-            fflush(stderr);
-            
-            dup2(stdout_backup, STDOUT_FILENO);
-            dup2(stderr_backup, STDERR_FILENO);
-            close(stdout_backup);
-            close(stderr_backup);
-            
-            char buffer[BUFFER_SIZE] = {0};
-            ssize_t bytes_read = read(pipefd[0], buffer, sizeof(buffer) - 1);
-            close(pipefd[0]);
-            
-            if (bytes_read > 0) {
-                buffer[bytes_read] = '\0';
-                send_to_client(task, buffer, 1);
-            } else {
-                send_to_client(task, "", 1);
-            }
-            
-            printf("[%d]<<< %zu bytes sent\n", task->client_id, task->bytes_sent);
-            scheduler_complete_task(task);
-            print_task_summary();
+            // the command runs alongside the worker, which goes on dispatching
+            // and completes it once its output ends and its stages are reaped
+            if (start_shell_command(task) != 0) send_to_client(task, "", 1);
+            finish_task(worker, task);
             
         } else if (task->type == TASK_PROGRAM) {
-            int time_to_execute = (task->remaining_time < quantum) ? 
-                                 task->remaining_time : quantum;
+            int time_to_execute = sched_slice_ms(task);
             
             if (task->preempted) {
                 printf("[%d]--- " COLOR_BLUE "running" COLOR_RESET " (%d)\n", 
-                      task->client_id, task->remaining_time);
+                      task->client_id, TASK_SECONDS(task->remaining_time));
                 task->preempted = 0;
             }
-            // simulate program execution by sleeping
-            char buffer[BUFFER_SIZE] = {0};
-            for (int i = 0; i < time_to_execute; i++) {
-                char line[64];
-                snprintf(line, sizeof(line), "Demo %d/%d\n", 
-                        task->total_time - task->remaining_time + i + 1, 
-                        task->total_time);
-                strcat(buffer, line);
-                sleep(1);
-            }
-            // send the output to the client
-            send_to_client(task, buffer, 0);
-            scheduler_update_task(task, time_to_execute);
-            
-            if (task->remaining_time <= 0) {
-                printf("[%d]<<< %zu bytes sent\n", task->client_id, task->bytes_sent);
-                send_to_client(task, "", 1);
-                scheduler_complete_task(task);
-                print_task_summary();
+            // the process is created on the task's first quantum
+            if (task->pid == 0 && task->output_fd < 0 && start_program(task) != 0) {
+                send_to_client(task, "Error: failed to start program.\n", 0);
+                time_to_execute = task->remaining_time;
+            } else if (run_program_quantum(worker, task, time_to_execute, &time_to_execute)) {
+                // the program finished, whatever its estimate said
+                time_to_execute = task->remaining_time;
+            } else if (time_to_execute >= task->remaining_time) {
+                // the estimate ran out before the program did, keep it schedulable
+                time_to_execute = task->remaining_time - 1;
             }
+            // its remaining output and prompt go out as the client takes them
+            if (!scheduler_update_task(task, time_to_execute)) finish_task(worker, task);
         }
     }
+    // shell commands already started run to completion
+    while (worker->inflight_count > 0) {
+        service_inflight(worker, NULL, 0, -1);
+    }
     return NULL;
 }
\ No newline at end of file
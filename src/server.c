@@ -2,6 +2,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <fcntl.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
@@ -22,12 +23,12 @@
 static int thread_count = 0;
 pthread_mutex_t thread_counter_mutex = PTHREAD_MUTEX_INITIALIZER;
 
-void start_server(int port) {
+void start_server(int port, const scheduler_config_t *config) {
     // setup signal handlers for proper termination
     setup_signal_handlers();
     
     // initialize the scheduler
-    scheduler_init();
+    scheduler_init(config);
     scheduler_start();
     
     // create socket variables
@@ -88,6 +89,9 @@ void start_server(int port) {
             perror("accept");
             continue;
         }
+        // workers relay output to it without blocking, a client that does not
+        // read holds back its own tasks and no one else's
+        fcntl(client_socket, F_SETFL, O_NONBLOCK);
         
         // get client info
         char client_ip[INET_ADDRSTRLEN];
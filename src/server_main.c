@@ -1,13 +1,103 @@
+#define _POSIX_C_SOURCE 200809L
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 #include "server.h"
+#include "scheduler.h"
+#include "sched_policy.h"
+#include "client_stats.h"
 
 #define DEFAULT_PORT 8080
 #define DEFAULT_IP "127.0.0.1"
 
-int main(void) {
-    printf("| Server Started on %s:%d |\n", DEFAULT_IP, DEFAULT_PORT);
-    start_server(DEFAULT_PORT);
+// print usage information
+static void print_usage(const char *program_name) {
+    fprintf(stderr, "Usage: %s [-p port] [-w workers] [-q max_tasks] [-a reject|block]\n"
+                    "       [-s %s] [-m quanta] [-b boost_ms] [-c cpu_ms]\n", program_name, sched_policy_names());
+    fprintf(stderr, "  -p port       port to listen on (default: %d)\n", DEFAULT_PORT);
+    fprintf(stderr, "  -w workers    executor threads (default: one per cpu)\n");
+    fprintf(stderr, "  -q max_tasks  tasks the queue accepts (default: unbounded)\n");
+    fprintf(stderr, "  -a policy     when the queue is full, reject the command or block the client (default: reject)\n");
+    fprintf(stderr, "  -s algorithm  scheduling policy for all tasks (default: sjrf)\n");
+    fprintf(stderr, "  -m quanta     comma separated mlfq slice per level in ms (default: 1000,3000,7000)\n");
+    fprintf(stderr, "  -b boost_ms   mlfq priority boost interval in ms, 0 disables it (default: 20000)\n");
+    fprintf(stderr, "  -c cpu_ms     recent cpu time that queues a client's tasks one level lower under every policy, 0 disables it (default: %d)\n",
+            CLIENT_CPU_PENALTY_DEFAULT_MS);
+}
+
+int main(int argc, char *argv[]) {
+    int port = DEFAULT_PORT;
+    scheduler_config_t config;
+    scheduler_config_defaults(&config);
+    
+    int opt;
+    while ((opt = getopt(argc, argv, "p:w:q:a:s:m:b:c:h")) != -1) {
+        switch (opt) {
+        case 'p':
+            port = atoi(optarg);
+            if (port <= 0 || port > 65535) {
+                fprintf(stderr, "Invalid port number. Using default port %d.\n", DEFAULT_PORT);
+                port = DEFAULT_PORT;
+            }
+            break;
+        case 'w':
+            config.num_workers = atoi(optarg);
+            if (config.num_workers <= 0) {
+                fprintf(stderr, "Invalid worker count. Using one per cpu.\n");
+                config.num_workers = 0;
+            }
+            break;
+        case 'q':
+            config.max_tasks = atoi(optarg);
+            if (config.max_tasks < 0) {
+                fprintf(stderr, "Invalid queue limit. Using an unbounded queue.\n");
+                config.max_tasks = 0;
+            }
+            break;
+        case 'a':
+            if (strcmp(optarg, "reject") == 0) {
+                config.admission = ADMISSION_REJECT;
+            } else if (strcmp(optarg, "block") == 0) {
+                config.admission = ADMISSION_BLOCK;
+            } else {
+                fprintf(stderr, "Unknown admission policy: %s\n", optarg);
+                print_usage(argv[0]);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 's': {
+            const sched_policy_t *policy = sched_policy_find(optarg);
+            if (!policy) {
+                fprintf(stderr, "Unknown scheduling algorithm: %s\n", optarg);
+                print_usage(argv[0]);
+                return EXIT_FAILURE;
+            }
+            config.algorithm = policy->id;
+            break;
+        }
+        case 'm':
+            config.mlfq_levels = scheduler_parse_quanta(optarg, config.mlfq_quantum_ms);
+            if (config.mlfq_levels < 0) {
+                fprintf(stderr, "Invalid mlfq quanta, expected up to %d positive values.\n", MLFQ_MAX_LEVELS);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'b':
+            config.mlfq_boost_ms = atoi(optarg);
+            if (config.mlfq_boost_ms < 0) config.mlfq_boost_ms = 0;
+            break;
+        case 'c':
+            config.cpu_penalty_ms = atoi(optarg);
+            if (config.cpu_penalty_ms < 0) config.cpu_penalty_ms = 0;
+            break;
+        default:
+            print_usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    
+    printf("| Server Started on %s:%d |\n", DEFAULT_IP, port);
+    start_server(port, &config);
     return 0;
-}
\ No newline at end of file
+}
@@ -17,4 +17,7 @@ void setup_signal_handlers(void) {
     // register signal handlers for proper program termination
     signal(SIGINT, handle_signal);  // handle Ctrl+C
     signal(SIGTERM, handle_signal); // handle termination signal
+    // output spliced to a client that went away fails with EPIPE instead of
+    // killing the server, children put the default back before exec
+    signal(SIGPIPE, SIG_IGN);
 }
\ No newline at end of file
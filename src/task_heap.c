@@ -0,0 +1,102 @@
+#include <stdlib.h>
+#include "task_heap.h"
+#include "scheduler.h"
+
+#define INITIAL_HEAP_CAPACITY 64
+
+// place a task at a slot and keep its handle in sync
+static void heap_set(task_heap_t *heap, int index, task_t *task) {
+    heap->items[index] = task;
+    task->heap_index = index;
+}
+
+// move the task at index towards the root until its parent runs first
+static void sift_up(task_heap_t *heap, int index) {
+    task_t *task = heap->items[index];
+    while (index > 0) {
+        int parent = (index - 1) / 2;
+        if (!heap->less(task, heap->items[parent])) break;
+        heap_set(heap, index, heap->items[parent]);
+        index = parent;
+    }
+    heap_set(heap, index, task);
+}
+
+// move the task at index towards the leaves until both children run later
+static void sift_down(task_heap_t *heap, int index) {
+    task_t *task = heap->items[index];
+    while (1) {
+        int child = 2 * index + 1;
+        if (child >= heap->size) break;
+        if (child + 1 < heap->size && heap->less(heap->items[child + 1], heap->items[child])) {
+            child++;
+        }
+        if (!heap->less(heap->items[child], task)) break;
+        heap_set(heap, index, heap->items[child]);
+        index = child;
+    }
+    heap_set(heap, index, task);
+}
+
+int task_heap_init(task_heap_t *heap, task_heap_less_fn less) {
+    heap->items = malloc(INITIAL_HEAP_CAPACITY * sizeof(task_t *));
+    if (!heap->items) return -1;
+    heap->size = 0;
+    heap->capacity = INITIAL_HEAP_CAPACITY;
+    heap->less = less;
+    return 0;
+}
+
+void task_heap_destroy(task_heap_t *heap) {
+    free(heap->items);
+    heap->items = NULL;
+    heap->size = 0;
+    heap->capacity = 0;
+}
+
+int task_heap_push(task_heap_t *heap, task_t *task) {
+    if (heap->size == heap->capacity) {
+        int new_capacity = heap->capacity * 2;
+        task_t **items = realloc(heap->items, new_capacity * sizeof(task_t *));
+        if (!items) return -1;
+        heap->items = items;
+        heap->capacity = new_capacity;
+    }
+    heap_set(heap, heap->size++, task);
+    sift_up(heap, task->heap_index);
+    return 0;
+}
+
+task_t *task_heap_peek(const task_heap_t *heap) {
+    return heap->size > 0 ? heap->items[0] : NULL;
+}
+
+task_t *task_heap_runner_up(const task_heap_t *heap) {
+    // the second best task is always one of the root's children
+    if (heap->size < 2) return NULL;
+    if (heap->size == 2) return heap->items[1];
+    return heap->less(heap->items[2], heap->items[1]) ? heap->items[2] : heap->items[1];
+}
+
+task_t *task_heap_pop(task_heap_t *heap) {
+    task_t *top = task_heap_peek(heap);
+    if (top) task_heap_remove(heap, top);
+    return top;
+}
+
+void task_heap_remove(task_heap_t *heap, task_t *task) {
+    int index = task->heap_index;
+    if (index < 0 || index >= heap->size || heap->items[index] != task) return;
+    
+    task->heap_index = -1;
+    heap->size--;
+    if (index == heap->size) return;
+    
+    // fill the hole with the last task and restore the order around it
+    heap_set(heap, index, heap->items[heap->size]);
+    if (index > 0 && heap->less(heap->items[index], heap->items[(index - 1) / 2])) {
+        sift_up(heap, index);
+    } else {
+        sift_down(heap, index);
+    }
+}
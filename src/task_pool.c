@@ -0,0 +1,87 @@
+#include <stdlib.h>
+#include <string.h>
+#include "task_pool.h"
+#include "scheduler.h"
+
+#define SLOTS_PER_SLAB 64
+
+// one pool entry, the task must stay first so a task pointer is a slot pointer
+typedef struct task_slot {
+    task_t task;
+    char command[TASK_POOL_INLINE_COMMAND];
+    struct task_slot *next_free;
+} task_slot_t;
+
+typedef struct task_slab {
+    struct task_slab *next;
+    task_slot_t slots[SLOTS_PER_SLAB];
+} task_slab_t;
+
+void task_pool_init(task_pool_t *pool) {
+    pool->free_list = NULL;
+    pool->slabs = NULL;
+    pool->slab_count = 0;
+    pool->in_use = 0;
+}
+
+void task_pool_destroy(task_pool_t *pool) {
+    task_slab_t *slab = pool->slabs;
+    while (slab) {
+        task_slab_t *next = slab->next;
+        // long commands live outside the slabs
+        for (int i = 0; i < SLOTS_PER_SLAB; i++) {
+            task_slot_t *slot = &slab->slots[i];
+            if (slot->task.command && slot->task.command != slot->command) {
+                free(slot->task.command);
+            }
+        }
+        free(slab);
+        slab = next;
+    }
+    task_pool_init(pool);
+}
+
+// add a slab worth of slots to the free list
+static int grow_pool(task_pool_t *pool) {
+    task_slab_t *slab = malloc(sizeof(task_slab_t));
+    if (!slab) return -1;
+    
+    for (int i = 0; i < SLOTS_PER_SLAB; i++) {
+        slab->slots[i].task.command = NULL;
+        slab->slots[i].next_free = pool->free_list;
+        pool->free_list = &slab->slots[i];
+    }
+    slab->next = pool->slabs;
+    pool->slabs = slab;
+    pool->slab_count++;
+    return 0;
+}
+
+task_t *task_pool_alloc(task_pool_t *pool, const char *command) {
+    if (!pool->free_list && grow_pool(pool) != 0) return NULL;
+    
+    task_slot_t *slot = pool->free_list;
+    size_t length = strlen(command);
+    char *storage = slot->command;
+    if (length >= TASK_POOL_INLINE_COMMAND) {
+        storage = malloc(length + 1);
+        if (!storage) return NULL;
+    }
+    pool->free_list = slot->next_free;
+    pool->in_use++;
+    
+    memset(&slot->task, 0, sizeof(task_t));
+    memcpy(storage, command, length + 1);
+    slot->task.command = storage;
+    return &slot->task;
+}
+
+void task_pool_free(task_pool_t *pool, task_t *task) {
+    task_slot_t *slot = (task_slot_t *)task;
+    if (task->command != slot->command) free(task->command);
+    task->command = NULL;
+    
+    slot->next_free = pool->free_list;
+    pool->free_list = slot;
+    pool->in_use--;
+}
@@ -2,6 +2,8 @@
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <errno.h>
+#include <poll.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
@@ -12,14 +14,108 @@
 #define MAX_INPUT_SIZE 1024
 #define MAX_OUTPUT_SIZE 4096
 
+// wait until the client socket is ready for events, it is non-blocking so
+// the workers never wait on a client
+static void wait_socket(int client_socket, short events) {
+    struct pollfd pfd = { .fd = client_socket, .events = events };
+    while (poll(&pfd, 1, -1) < 0 && errno == EINTR) {}
+}
+
+// send all of a message, waiting for room when the client is slow to read
+static void send_all(int client_socket, const char *message, size_t length) {
+    while (length > 0) {
+        ssize_t sent_bytes = send(client_socket, message, length, MSG_NOSIGNAL);
+        if (sent_bytes > 0) {
+            message += sent_bytes;
+            length -= sent_bytes;
+        } else if (sent_bytes < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            wait_socket(client_socket, POLLOUT);
+        } else if (sent_bytes == 0 || errno != EINTR) {
+            return;
+        }
+    }
+}
+
+// receive the next command, waiting for one like a blocking recv would
+static ssize_t receive_command(int client_socket, char *input, size_t size) {
+    for (;;) {
+        ssize_t bytes_received = recv(client_socket, input, size, 0);
+        if (bytes_received >= 0) return bytes_received;
+        if (errno == EAGAIN || errno == EWOULDBLOCK) wait_socket(client_socket, POLLIN);
+        else if (errno != EINTR) return -1;
+    }
+}
+
+// send a reply followed by the prompt
+static void send_reply(int client_socket, const char *reply) {
+    char message[MAX_OUTPUT_SIZE];
+    int length = snprintf(message, sizeof(message), "%s$ ", reply);
+    if (length >= (int)sizeof(message)) length = sizeof(message) - 1;
+    send_all(client_socket, message, length);
+}
+
+// handles the commands the server answers itself, returns 1 if it was one
+static int handle_builtin(int client_socket, const char *command, int client_id) {
+    char reply[MAX_OUTPUT_SIZE];
+    int task_id;
+    
+    // "tasks" lists the client's queued and running tasks
+    if (strcmp(command, "tasks") == 0) {
+        if (scheduler_list_client_tasks(client_id, reply, sizeof(reply)) == 0) {
+            snprintf(reply, sizeof(reply), "No tasks.\n");
+        }
+        send_reply(client_socket, reply);
+        return 1;
+    }
+    // "stats" reports what the client's completed tasks used
+    if (strcmp(command, "stats") == 0) {
+        if (scheduler_client_usage(client_id, reply, sizeof(reply)) != 0) {
+            snprintf(reply, sizeof(reply), "No completed tasks.\n");
+        }
+        send_reply(client_socket, reply);
+        return 1;
+    }
+    // "cancel <id>" drops one of the client's tasks
+    if (strncmp(command, "cancel ", 7) == 0) {
+        if (sscanf(command + 7, "%d", &task_id) == 1 && 
+            scheduler_cancel_task(client_id, task_id) == 0) {
+            snprintf(reply, sizeof(reply), "Task %d cancelled.\n", task_id);
+        } else {
+            snprintf(reply, sizeof(reply), "Error: no such task.\n");
+        }
+        send_reply(client_socket, reply);
+        return 1;
+    }
+    return 0;
+}
+
 // handles commands received from clients
 void handle_command(int client_socket, const char *command, int client_id) {
+    // optional "priority <n> " and "deadline <ms> " prefixes, in any order
+    int priority = 0;
+    int deadline_ms = 0;
+    int value, prefix_length;
+    while (command) {
+        prefix_length = 0;
+        if (sscanf(command, "priority %d %n", &value, &prefix_length) == 1 && prefix_length > 0) {
+            priority = value;
+            if (priority < TASK_PRIORITY_MIN) priority = TASK_PRIORITY_MIN;
+            if (priority > TASK_PRIORITY_MAX) priority = TASK_PRIORITY_MAX;
+        } else if (sscanf(command, "deadline %d %n", &value, &prefix_length) == 1 && prefix_length > 0) {
+            deadline_ms = value > 0 ? value : 0;
+        } else {
+            break;
+        }
+        command += prefix_length;
+    }
+    
     // handle empty commands by just sending prompt back
     if (!command || strlen(command) == 0) {
         const char *prompt = "$ ";
-        send(client_socket, prompt, strlen(prompt), 0);
+        send_all(client_socket, prompt, strlen(prompt));
         return;
     }
+    if (handle_builtin(client_socket, command, client_id)) return;
 
     int is_program = 0;
     int execution_time = -1;
@@ -34,9 +130,13 @@ void handle_command(int client_socket, const char *command, int client_id) {
     }
     
     // add task to scheduler queue - scheduler handles execution and output
-    scheduler_add_task(client_id, client_socket, command, 
-                      is_program ? TASK_PROGRAM : TASK_SHELL_COMMAND, 
-                      execution_time);
+    if (scheduler_add_task(client_id, client_socket, command, 
+                           is_program ? TASK_PROGRAM : TASK_SHELL_COMMAND, 
+                           execution_time, priority, deadline_ms) != 0) {
+        // the task was refused, the client still needs an answer and a prompt
+        const char *busy = "Error: server is busy, command rejected.\n$ ";
+        send_all(client_socket, busy, strlen(busy));
+    }
 }
 
 // handles individual client connections in separate threads
@@ -50,17 +150,17 @@ void *handle_client(void *arg) {
     
     // send initial prompt to new client
     const char *prompt = "$ ";
-    send(client_socket, prompt, strlen(prompt), 0);
+    send_all(client_socket, prompt, strlen(prompt));
     
     // main client communication loop
-    while ((bytes_received = recv(client_socket, input, sizeof(input) - 1, 0)) > 0) {
+    while ((bytes_received = receive_command(client_socket, input, sizeof(input) - 1)) > 0) {
         input[bytes_received] = '\0';
         
         // handle exit command
         if (strcmp(input, "exit") == 0) {
             printf("[%d]>>> exit\n", client_id);
             const char *goodbye = "Disconnected from server.\n";
-            send(client_socket, goodbye, strlen(goodbye), 0);
+            send_all(client_socket, goodbye, strlen(goodbye));
             break;
         }
         
@@ -0,0 +1,29 @@
+#!/bin/sh
+# cancel a running program from the stock client: the server announces the
+# task's id when it accepts it, the client sends "cancel <id>" while it waits
+# for the program, and the program is killed long before it would finish
+PORT=${PORT:-9097}
+log=$(mktemp)
+
+./server -p "$PORT" -w 1 > "$log" 2>&1 &
+server=$!
+trap 'kill $server 2>/dev/null; rm -f "$log"' EXIT
+sleep 1
+
+started=$(date +%s)
+output=$( (echo "demo 30"; sleep 2; echo "cancel 1"; sleep 1; echo "exit"; sleep 1) | ./client "$PORT")
+elapsed=$(( $(date +%s) - started ))
+
+fail() {
+    echo "cancel_running: $1"
+    echo "$output"
+    exit 1
+}
+echo "$output" | grep -q '\[task 1\]' || fail "no task id announced"
+echo "$output" | grep -q 'Task 1 cancelled' || fail "running task not cancelled"
+[ "$elapsed" -lt 10 ] || fail "took ${elapsed}s, the program ran to its end"
+# the server's log is only complete once it shut down
+kill $server
+wait $server 2>/dev/null
+grep -q 'exited (signal 9' "$log" || fail "program was not killed"
+echo "cancel_running: ok"